@@ -52,15 +52,12 @@ void ListScene::drawItem(int index, M5Canvas &drawBuffer, int width, int height)
 
     ListItem item = { "" , "" , "選択" } ;
     itemForRow(index, item);
-    drawBuffer.setTextColor(isSelected ? 2 : 0);
+    int color = isSelected ? 2 : 0;
     if (item.value.empty()) {
-        drawBuffer.setFont(&lgfxJapanGothicP_24);
-        drawBuffer.drawString(item.title.c_str(), 8, 13);
+        drawText(drawBuffer, &lgfxJapanGothicP_24, item.title, 8, 13, color);
     } else {
-        drawBuffer.setFont(&lgfxJapanGothicP_24);
-        drawBuffer.drawString(item.title.c_str(), 8, 4);
-        drawBuffer.setFont(&lgfxJapanGothicP_16);
-        drawBuffer.drawString(item.value.c_str(), 8, 28);
+        drawText(drawBuffer, &lgfxJapanGothicP_24, item.title, 8, 4, color);
+        drawText(drawBuffer, &lgfxJapanGothicP_16, item.value, 8, 28, color);
     }
     if (index == selectedRow) drawButton(2, 1, item.button);
 }
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "esp_timer.h"
+#include "ui.hpp"
+
+UI_IMPL_BEGIN
+
+// Strings are rasterized once into a 1-bit canvas and kept as packed bitmaps, drawing them again is
+// a blit of horizontal runs without decoding the glyphs. Numerals are cached one glyph at a time so
+// changing values like the intensity or the countdown share a few entries instead of filling the atlas.
+// With a background color the line is composed in a 16-bit sprite and sent in one push, drawing each
+// run on the panel would set up a transfer per run.
+// Used from the UI task only.
+namespace {
+
+constexpr int atlasCapacity = 48;
+constexpr size_t atlasBudget = 12 * 1024; // bytes of bitmaps
+constexpr int maxSegments = 24;
+
+struct Entry {
+    const lgfx::IFont *font = nullptr;
+    string text;
+    uint16_t width = 0, height = 0;
+    std::vector<uint8_t> bits; // rows of (width + 7) / 8 bytes, MSB first
+    uint32_t lastUsed = 0;
+
+    size_t stride() const { return (width + 7) / 8; }
+};
+Entry entries[atlasCapacity];
+size_t atlasBytes = 0;
+uint32_t atlasClock = 0, hits = 0, misses = 0, evictions = 0, fallbacks = 0;
+uint32_t draws = 0, pushes = 0;
+int64_t drawTime = 0, pushTime = 0; // usec
+
+bool isNumeral(char c) {
+    return (c >= '0' && c <= '9') || c == 'M' || c == '+' || c == '-' || c == '.';
+}
+
+void release(Entry &entry) {
+    atlasBytes -= entry.bits.size();
+    entry.font = nullptr;
+    entry.text.clear();
+    entry.text.shrink_to_fit();
+    entry.bits.clear();
+    entry.bits.shrink_to_fit();
+}
+
+// Frees the least recently used entries until size fits, entries used by the current draw are kept.
+Entry *slot(size_t size) {
+    if (size > atlasBudget) return nullptr;
+    Entry *empty = nullptr;
+    for (auto &entry : entries) {
+        if (!entry.font) empty = &entry;
+    }
+    while (!empty || atlasBytes + size > atlasBudget) {
+        Entry *oldest = nullptr;
+        for (auto &entry : entries) {
+            if (!entry.font || entry.lastUsed == atlasClock) continue;
+            if (!oldest || entry.lastUsed < oldest->lastUsed) oldest = &entry;
+        }
+        if (!oldest) return nullptr;
+        release(*oldest);
+        evictions++;
+        empty = oldest;
+    }
+    return empty;
+}
+
+Entry *render(const lgfx::IFont *font, const char *text, size_t length) {
+    string str(text, length);
+    M5Canvas canvas;
+    canvas.setColorDepth(1);
+    canvas.setFont(font);
+    int width = canvas.textWidth(str.c_str()), height = canvas.fontHeight();
+    if (width <= 0 || height <= 0) return nullptr;
+    size_t stride = (width + 7) / 8;
+    Entry *entry = slot(stride * height);
+    if (!entry || !canvas.createSprite(width, height)) return nullptr;
+    canvas.clear(0);
+    canvas.setTextColor(1);
+    canvas.drawString(str.c_str(), 0, 0);
+
+    entry->bits.assign(stride * height, 0);
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = &entry->bits[y * stride];
+        for (int x = 0; x < width; x++) {
+            if (canvas.readPixelValue(x, y)) row[x >> 3] |= 0x80 >> (x & 7);
+        }
+    }
+    canvas.deleteSprite();
+    entry->font = font;
+    entry->text = std::move(str);
+    entry->width = width;
+    entry->height = height;
+    atlasBytes += entry->bits.size();
+    return entry;
+}
+
+Entry *lookup(const lgfx::IFont *font, const char *text, size_t length) {
+    Entry *found = nullptr;
+    for (auto &entry : entries) {
+        if (entry.font == font && entry.text.size() == length && memcmp(entry.text.data(), text, length) == 0) {
+            found = &entry;
+            break;
+        }
+    }
+    if (found) {
+        hits++;
+    } else {
+        misses++;
+        found = render(font, text, length);
+    }
+    if (found) found->lastUsed = atlasClock;
+    return found;
+}
+
+void blit(LovyanGFX &target, const Entry &entry, int x, int y, int color) {
+    size_t stride = entry.stride();
+    for (int row = 0; row < entry.height; row++) {
+        const uint8_t *bits = &entry.bits[row * stride];
+        int col = 0;
+        while (col < entry.width) {
+            if ((col & 7) == 0 && bits[col >> 3] == 0) {
+                col += 8;
+                continue;
+            }
+            if (!(bits[col >> 3] & (0x80 >> (col & 7)))) {
+                col++;
+                continue;
+            }
+            int start = col;
+            while (col < entry.width && (bits[col >> 3] & (0x80 >> (col & 7)))) col++;
+            target.drawFastHLine(x + start, y + row, col - start, color);
+        }
+    }
+}
+
+void drawUncached(LovyanGFX &target, const lgfx::IFont *font, const string &text, int x, int y, int color, TextAlign align, int background) {
+    fallbacks++;
+    target.setFont(font);
+    if (background >= 0) target.setTextColor(color, background);
+    else target.setTextColor(color);
+    switch (align) {
+    case TextAlign::Left: target.drawString(text.c_str(), x, y); break;
+    case TextAlign::Center: target.drawCenterString(text.c_str(), x, y); break;
+    case TextAlign::Right: target.drawRightString(text.c_str(), x, y); break;
+    }
+}
+
+}
+
+void drawText(LovyanGFX &target, const lgfx::IFont *font, const string &text, int x, int y, int color, TextAlign align, int background) {
+    if (text.empty()) return;
+    int64_t start = esp_timer_get_time();
+    atlasClock++;
+
+    // numerals are single glyph segments, anything between them is one segment
+    Entry *segments[maxSegments];
+    int count = 0, width = 0, height = 0;
+    for (size_t i = 0; i < text.size();) {
+        size_t length = 1;
+        if (!isNumeral(text[i])) {
+            while (i + length < text.size() && !isNumeral(text[i + length])) length++;
+        }
+        Entry *entry = count < maxSegments ? lookup(font, text.data() + i, length) : nullptr;
+        if (!entry) {
+            drawUncached(target, font, text, x, y, color, align, background);
+            return;
+        }
+        segments[count++] = entry;
+        width += entry->width;
+        height = std::max<int>(height, entry->height);
+        i += length;
+    }
+
+    if (align == TextAlign::Center) x -= width / 2;
+    else if (align == TextAlign::Right) x -= width;
+    if (background >= 0) {
+        M5Canvas canvas;
+        canvas.setColorDepth(16);
+        if (canvas.createSprite(width, height)) {
+            canvas.fillSprite(background);
+            for (int i = 0, left = 0; i < count; i++) {
+                blit(canvas, *segments[i], left, 0, color);
+                left += segments[i]->width;
+            }
+            canvas.pushSprite(&target, x, y);
+            canvas.deleteSprite();
+            pushes++;
+            pushTime += esp_timer_get_time() - start;
+            return;
+        }
+    }
+    target.startWrite();
+    for (int i = 0; i < count; i++) {
+        blit(target, *segments[i], x, y, color);
+        x += segments[i]->width;
+    }
+    target.endWrite();
+    draws++;
+    drawTime += esp_timer_get_time() - start;
+}
+
+void printTextAtlas() {
+    int used = 0;
+    for (auto &entry : entries) {
+        if (entry.font) used++;
+    }
+    printf("text atlas: entries %d/%d, %u bytes, hits %u, misses %u, evictions %u, uncached %u\n", used, atlasCapacity,
+        (unsigned)atlasBytes, (unsigned)hits, (unsigned)misses, (unsigned)evictions, (unsigned)fallbacks);
+    printf("  runs: %u draws, avg %uus; pushed: %u draws, avg %uus\n", (unsigned)draws, (unsigned)(draws ? drawTime / draws : 0),
+        (unsigned)pushes, (unsigned)(pushes ? pushTime / pushes : 0));
+    hits = misses = evictions = fallbacks = draws = pushes = 0;
+    drawTime = pushTime = 0;
+}
+
+UI_IMPL_END
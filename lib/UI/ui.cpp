@@ -41,8 +41,8 @@ void run() {
     uiTask->run();
 }
 
-void send(std::function<void(void)> func) {
-    if (uiTask.has_value()) uiTask->send(func);
+RTOS::MessageQueue *messageQueue() {
+    return uiTask.has_value() ? uiTask->messageQueue() : nullptr;
 }
 
 void UITask::cycle() {
@@ -57,6 +57,10 @@ void setRootScene(shared_ptr<Scene> scene) {
     rootScene = scene;
 }
 
+void setFrameInterval(int ms) {
+    if (uiTask.has_value()) uiTask->setCycle(pdMS_TO_TICKS(ms));
+}
+
 void Scene::didLoad() {}
 void Scene::willAppear() {}
 void Scene::didAppear() {}
@@ -93,8 +97,6 @@ void Scene::clearButton(int index, int width, int color) {
 }
 
 void Scene::drawButton(int index, int size, string text, int color, int backgroundColor) {
-    M5.Display.setTextColor(color, backgroundColor);
-    M5.Display.setFont(&lgfxJapanGothicP_24);
     int displayWidth = M5.Display.width(), displayHeight = M5.Display.height();
 
     static constexpr auto buttonRect = [](uint8_t rotation, int index, int displayWidth, int displayHeight, uint16_t *rect) {
@@ -126,7 +128,7 @@ void Scene::drawButton(int index, int size, string text, int color, int backgrou
 
     M5.Display.fillRect(rect[0] + 1, rect[1] + 1, rect[2] - 2, rect[3] - 2, backgroundColor);
     M5.Display.drawRoundRect(rect[0], rect[1], rect[2], rect[3], 2, color);
-    M5.Display.drawCenterString(text.c_str(), rect[0] + rect[2] / 2, rect[1] + (rect[3] - 24) / 2);
+    drawText(M5.Display, &lgfxJapanGothicP_24, text, rect[0] + rect[2] / 2, rect[1] + (rect[3] - 24) / 2, color, TextAlign::Center, backgroundColor);
 }
 
 void Scene::presentScene(shared_ptr<Scene> scene) {
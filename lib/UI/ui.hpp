@@ -56,8 +56,20 @@ extern shared_ptr<Scene> activeScene;
 bool isUITask();
 void init();
 void run();
-void send(std::function<void(void)> func);
+RTOS::MessageQueue *messageQueue();
+template<class F>
+void send(F &&func) {
+    if (auto queue = messageQueue()) queue->send(std::forward<F>(func));
+}
 void setRootScene(shared_ptr<Scene> scene);
+void setFrameInterval(int ms);
+
+// Text drawn through the atlas of pre-rendered strings, see text_atlas.cpp. Only the glyphs are
+// drawn unless a background color is given, color is used as for setTextColor and x is the left,
+// center or right of the text. Text drawn straight to the panel should give its background.
+enum class TextAlign { Left, Center, Right };
+void drawText(LovyanGFX &target, const lgfx::IFont *font, const string &text, int x, int y, int color, TextAlign align = TextAlign::Left, int background = -1);
+void printTextAtlas();
 
 struct ListItem {
     string title;
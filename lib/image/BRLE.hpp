@@ -4,6 +4,7 @@
 
 #pragma once
 #include <cstdint>
+#include <cstring>
 #include <functional>
 #include <vector>
 
@@ -36,9 +37,47 @@ inline void decode(std::vector<uint8_t> &encoded, uint8_t bg, std::function<void
     size_t i = 0, n = encoded.size(), runLength;
     while (i < n) {
         runLength = encoded[i++];
-        for (int j = 0; j < runLength; j++) byte(bg);
+        for (size_t j = 0; j < runLength; j++) byte(bg);
         runLength = encoded[i++];
-        for (int j = 0; j < runLength; j++) byte(encoded[i++]);
+        for (size_t j = 0; j < runLength; j++) byte(encoded[i++]);
+    }
+}
+
+// Encodes into a buffer of capacity bytes, returns the encoded size or -1 if it does not fit.
+inline int encode(const uint8_t *pixels, int length, uint8_t bg, uint8_t *encoded, int capacity) {
+    int i = 0, size = 0;
+    while (i < length) {
+        if (size + 2 > capacity) return -1;
+        int runLength = 0;
+        while (i < length && pixels[i] == bg && runLength < 255) {
+            runLength++;
+            i++;
+        }
+        encoded[size++] = runLength;
+
+        int index = size++;
+        runLength = 0;
+        while (i < length && pixels[i] != bg && runLength < 255) {
+            if (size == capacity) return -1;
+            runLength++;
+            encoded[size++] = pixels[i++];
+        }
+        encoded[index] = runLength;
+    }
+    return size;
+}
+
+// Decodes into pixels, which must hold the encoded length.
+inline void decode(const uint8_t *encoded, int size, uint8_t bg, uint8_t *pixels) {
+    int i = 0;
+    while (i < size) {
+        int runLength = encoded[i++];
+        memset(pixels, bg, runLength);
+        pixels += runLength;
+        runLength = encoded[i++];
+        memcpy(pixels, &encoded[i], runLength);
+        pixels += runLength;
+        i += runLength;
     }
 }
 
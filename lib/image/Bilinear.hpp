@@ -19,21 +19,22 @@ inline float interpolate2d(T *p, float px, float py) {
     return interpolate(i0x, i1x, py);
 }
 
+// Resizes the fw x fh window at fx, fy of an image with stride pixels per row to tw x th.
 template<class T>
-inline void resize(int fw, int fh, int tw, int th, const T *data,
+inline void resize(int stride, float fx, float fy, float fw, float fh, int tw, int th, const T *data,
     std::function<void(int, int, T)> dot,
     std::function<void(int x, int y, T, T*, T*, T*)> toRGB, std::function<T(T, T, T)> fromRGB) {
-    const float scaleX = (float)fw / tw, scaleY = (float)fh / th;
+    const float scaleX = fw / tw, scaleY = fh / th;
     for (int y = 0; y < th; y++) {
         for (int x = 0; x < tw; x++) {
-            const float sx = x * scaleX, sy = y * scaleY;
+            const float sx = fx + x * scaleX, sy = fy + y * scaleY;
             const int isx = (int)sx, isy = (int)sy;
 
             T pixels[4] = {
-                data[(isy    ) * fw + (isx    )],
-                data[(isy    ) * fw + (isx + 1)],
-                data[(isy + 1) * fw + (isx    )],
-                data[(isy + 1) * fw + (isx + 1)],
+                data[(isy    ) * stride + (isx    )],
+                data[(isy    ) * stride + (isx + 1)],
+                data[(isy + 1) * stride + (isx    )],
+                data[(isy + 1) * stride + (isx + 1)],
             };
             if (pixels[0] == pixels[1] && pixels[0] == pixels[2] && pixels[0] == pixels[3]) {
                 dot(x, y, pixels[0]);
@@ -54,6 +55,13 @@ inline void resize(int fw, int fh, int tw, int th, const T *data,
     }
 }
 
+template<class T>
+inline void resize(int fw, int fh, int tw, int th, const T *data,
+    std::function<void(int, int, T)> dot,
+    std::function<void(int x, int y, T, T*, T*, T*)> toRGB, std::function<T(T, T, T)> fromRGB) {
+    resize<T>(fw, 0, 0, fw, fh, tw, th, data, dot, toRGB, fromRGB);
+}
+
 template<class T>
 inline void resize(int fw, int fh, int tw, int th, const T *data, std::function<void(int, int, T)> dot, T rm, T gm, T bm) {
     resize<T>(fw, fh, tw, th, data, dot, [=](int x, int y, T value, T *r, T *g, T *b) {
@@ -65,6 +73,23 @@ inline void resize(int fw, int fh, int tw, int th, const T *data, std::function<
     });
 }
 
+// RGB565 at the 16.16 fixed point position sx, sy, the right and bottom edges are clamped.
+inline uint16_t sample565(const uint16_t *data, int fw, int fh, uint32_t sx, uint32_t sy) {
+    int x0 = sx >> 16, y0 = sy >> 16;
+    int x1 = x0 + 1 < fw ? x0 + 1 : x0, y1 = y0 + 1 < fh ? y0 + 1 : y0;
+    uint32_t p[4] = { data[y0 * fw + x0], data[y0 * fw + x1], data[y1 * fw + x0], data[y1 * fw + x1] };
+    if (p[0] == p[1] && p[0] == p[2] && p[0] == p[3]) return p[0];
+    uint32_t px = (sx >> 8) & 0xff, py = (sy >> 8) & 0xff;
+    uint32_t w[4] = { (256 - px) * (256 - py), px * (256 - py), (256 - px) * py, px * py };
+    uint32_t r = 0, g = 0, b = 0;
+    for (int i = 0; i < 4; i++) {
+        r += (p[i] >> 11) * w[i];
+        g += ((p[i] >> 5) & 0x3f) * w[i];
+        b += (p[i] & 0x1f) * w[i];
+    }
+    return (((r + 32768) >> 16) << 11) | (((g + 32768) >> 16) << 5) | ((b + 32768) >> 16);
+}
+
 template<class T>
 inline void reduce(int fw, int fh, int tw, int th, T *data, T rm, T gm, T bm) {
     resize(fw, fh, tw, th, data, [=](int x, int y, T value) {
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+// Composites an RGB332 overlay with a transparent key over a byte-swapped RGB565 base row in one
+// pass, writing byte-swapped RGB565 as the display expects it.
+namespace Composite {
+
+// Byte-swapped RGB565 of an RGB332 color, the components are expanded by bit replication.
+inline constexpr uint16_t swap565(uint8_t color) {
+    uint32_t r = color >> 5, g = (color >> 2) & 0b111, b = color & 0b11;
+    uint32_t r5 = (r << 2) | (r >> 1), g6 = (g << 3) | g, b5 = (b << 3) | (b << 1) | (b >> 1);
+    uint32_t value = (r5 << 11) | (g6 << 5) | b5;
+    return (uint16_t)((value >> 8) | ((value & 0xff) << 8));
+}
+
+struct Table {
+    uint16_t color[256];
+    constexpr Table() : color() {
+        for (int i = 0; i < 256; i++) color[i] = swap565(i);
+    }
+};
+inline constexpr Table TABLE;
+
+// Length of the run of transparent pixels at the start of overlay, checked a word at a time.
+inline int transparentRun(const uint8_t *overlay, int width, uint8_t transparent) {
+    const uint32_t key = transparent * 0x01010101u;
+    int i = 0;
+    for (; i + 4 <= width; i += 4) {
+        uint32_t word;
+        memcpy(&word, overlay + i, 4);
+        if (word != key) break;
+    }
+    while (i < width && overlay[i] == transparent) i++;
+    return i;
+}
+
+// dst = overlay over base for one row, overlay may be nullptr for the base only.
+inline void row(uint16_t *dst, const uint16_t *base, const uint8_t *overlay, int width, uint8_t transparent = 255) {
+    if (!overlay) {
+        memcpy(dst, base, width * sizeof(uint16_t));
+        return;
+    }
+    int i = 0;
+    while (i < width) {
+        int run = transparentRun(overlay + i, width - i, transparent);
+        if (run > 0) {
+            memcpy(dst + i, base + i, run * sizeof(uint16_t));
+            i += run;
+        }
+        while (i < width && overlay[i] != transparent) {
+            dst[i] = TABLE.color[overlay[i]];
+            i++;
+        }
+    }
+}
+
+// Writes the opaque overlay pixels of one row over dst in place.
+inline void overlayRow(uint16_t *dst, const uint8_t *overlay, int width, uint8_t transparent = 255) {
+    int i = 0;
+    while (i < width) {
+        i += transparentRun(overlay + i, width - i, transparent);
+        while (i < width && overlay[i] != transparent) {
+            dst[i] = TABLE.color[overlay[i]];
+            i++;
+        }
+    }
+}
+
+// Composites a block of rows, the strides are in pixels.
+inline void rect(uint16_t *dst, int dstStride, const uint16_t *base, const uint8_t *overlay, int srcStride, int width, int height, uint8_t transparent = 255) {
+    for (int y = 0; y < height; y++) {
+        row(dst + y * dstStride, base + y * srcStride, overlay ? overlay + y * srcStride : nullptr, width, transparent);
+    }
+}
+
+// overlayRow for a block of rows, the strides are in pixels.
+inline void overlayRect(uint16_t *dst, int dstStride, const uint8_t *overlay, int srcStride, int width, int height, uint8_t transparent = 255) {
+    for (int y = 0; y < height; y++) overlayRow(dst + y * dstStride, overlay + y * srcStride, width, transparent);
+}
+
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#include "networking.hpp"
+#include "rtos.hpp"
+#include "date.hpp"
+#include "esp_log.h"
+#include "lwip/netdb.h"
+#include "lwip/sockets.h"
+
+NETWORKING_IMPL_BEGIN
+
+static const char *TAG = "dns_cache";
+
+// lwIP does not expose the record TTL through getaddrinfo, so entries live for a fixed time
+// that stays below the usual TTL of the kmoni host and are refreshed before they expire.
+static constexpr int CACHE_SIZE = 4;
+static constexpr int CACHE_TTL = 300 * 1000;
+static constexpr int REFRESH_MARGIN = 30 * 1000;
+
+struct DNSCacheEntry {
+    char host[64];
+    char address[16];
+    Date expires = 0;
+    Date lastUsed = 0;
+    bool isStatic = false;
+};
+static DNSCacheEntry entries[CACHE_SIZE] = {};
+static RTOS::Semaphore mutex = RTOS::Semaphore::mutex();
+
+class DNSRefreshTask : public RTOS::Task<pdMS_TO_TICKS(1000)> {
+    using RTOS::Task<pdMS_TO_TICKS(1000)>::Task;
+    virtual void cycle() override;
+};
+static optional<DNSRefreshTask> refreshTask = std::nullopt;
+
+static DNSCacheEntry *find(const string &host) {
+    for (auto &entry : entries) {
+        if (entry.host[0] && host == entry.host) return &entry;
+    }
+    return nullptr;
+}
+
+static DNSCacheEntry *insert() {
+    DNSCacheEntry *target = nullptr;
+    for (auto &entry : entries) {
+        if (entry.isStatic) continue;
+        if (!entry.host[0]) return &entry;
+        if (!target || entry.lastUsed < target->lastUsed) target = &entry;
+    }
+    return target;
+}
+
+static bool lookup(const string &host, char *address, size_t length) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *result = nullptr;
+    int err = getaddrinfo(host.c_str(), nullptr, &hints, &result);
+    if (err != 0 || !result) {
+        ESP_LOGW(TAG, "getaddrinfo %s failed: %d", host.c_str(), err);
+        return false;
+    }
+    auto addr = &((struct sockaddr_in *)result->ai_addr)->sin_addr;
+    bool success = inet_ntop(AF_INET, addr, address, length) != nullptr;
+    freeaddrinfo(result);
+    return success;
+}
+
+static void store(const string &host, const char *address) {
+    mutex.take();
+    auto entry = find(host);
+    if (!entry && (entry = insert())) {
+        strlcpy(entry->host, host.c_str(), sizeof(entry->host));
+        entry->lastUsed = Date();
+    }
+    if (entry && !entry->isStatic) {
+        strlcpy(entry->address, address, sizeof(entry->address));
+        entry->expires = Date() + CACHE_TTL;
+    }
+    mutex.give();
+}
+
+void DNSRefreshTask::cycle() {
+    if (!isNetworkConnected()) return;
+    for (int i = 0; i < CACHE_SIZE; i++) {
+        mutex.take();
+        auto &entry = entries[i];
+        Date now;
+        bool refresh = entry.host[0] && !entry.isStatic && entry.expires - now < REFRESH_MARGIN && now - entry.lastUsed < CACHE_TTL;
+        string host = refresh ? entry.host : "";
+        mutex.give();
+        if (!refresh) continue;
+
+        char address[16];
+        if (lookup(host, address, sizeof(address))) {
+            ESP_LOGI(TAG, "refreshed %s: %s", host.c_str(), address);
+            store(host, address);
+        }
+    }
+}
+
+bool resolve(const string &host, string &address) {
+    if (host.size() >= sizeof(DNSCacheEntry::host)) return false;
+    mutex.take();
+    auto entry = find(host);
+    bool hit = entry && (entry->isStatic || Date() < entry->expires);
+    if (entry) entry->lastUsed = Date();
+    if (hit) address = entry->address;
+    mutex.give();
+    if (hit) return true;
+
+    char resolved[16];
+    if (!lookup(host, resolved, sizeof(resolved))) return false;
+    store(host, resolved);
+    address = resolved;
+    mutex.take();
+    if (!refreshTask.has_value()) {
+        refreshTask.emplace("dns");
+        refreshTask->start(RTOS::TaskPriority::Low, 1024 * 3, 0);
+    }
+    mutex.give();
+    return true;
+}
+
+void setStaticAddress(const string &host, const string &address) {
+    if (host.size() >= sizeof(DNSCacheEntry::host) || address.size() >= sizeof(DNSCacheEntry::address)) return;
+    mutex.take();
+    auto entry = find(host);
+    if (!entry) entry = insert();
+    if (entry) {
+        strlcpy(entry->host, host.c_str(), sizeof(entry->host));
+        strlcpy(entry->address, address.c_str(), sizeof(entry->address));
+        entry->isStatic = true;
+    }
+    mutex.give();
+}
+
+void invalidateAddress(const string &host) {
+    mutex.take();
+    auto entry = find(host);
+    if (entry && !entry->isStatic) entry->expires = 0;
+    mutex.give();
+}
+
+NETWORKING_IMPL_END
@@ -5,36 +5,54 @@
 #include "networking.hpp"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_timer.h"
+#include "trace.hpp"
 
 NETWORKING_IMPL_BEGIN
 
 static const char *TAG = "HTTPC";
 
+// The socket timeout only bounds each read, so a request past its deadline is aborted from here.
+static bool shouldAbort(HTTPClient *client) {
+    if (client->cancelled) return true;
+    if (client->deadline && esp_timer_get_time() >= client->deadline) client->expired = true;
+    return client->expired;
+}
+
 static esp_err_t http_event_handler(esp_http_client_event_t *evt) {
+    auto client = static_cast<HTTPClient*>(evt->user_data);
+    if ((evt->event_id == HTTP_EVENT_ON_HEADER || evt->event_id == HTTP_EVENT_ON_DATA) && shouldAbort(client)) {
+        ESP_LOGD(TAG, "request %s", client->cancelled ? "cancelled" : "expired");
+        esp_http_client_cancel_request(evt->client);
+        return ESP_OK;
+    }
     switch(evt->event_id) {
         case HTTP_EVENT_ERROR:
             ESP_LOGD(TAG, "HTTP_EVENT_ERROR");
             break;
         case HTTP_EVENT_ON_CONNECTED:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
+            client->timing.connected = esp_timer_get_time();
             break;
         case HTTP_EVENT_HEADER_SENT:
             ESP_LOGD(TAG, "HTTP_EVENT_HEADER_SENT");
+            client->timing.headerSent = esp_timer_get_time();
             break;
         case HTTP_EVENT_ON_HEADER:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+            if (!client->timing.firstByte) client->timing.firstByte = esp_timer_get_time();
             break;
         case HTTP_EVENT_ON_DATA:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
             // printf("%s\n", (char*)evt->data);
             if (!esp_http_client_is_chunked_response(evt->client)) {
-                auto client = static_cast<HTTPClient*>(evt->user_data);
                 client->onData((uint8_t*)evt->data, client->received, evt->data_len);
                 client->received += evt->data_len;
             }
             break;
         case HTTP_EVENT_ON_FINISH:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_FINISH");
+            client->timing.finish = esp_timer_get_time();
             break;
         case HTTP_EVENT_DISCONNECTED:
             ESP_LOGD(TAG, "HTTP_EVENT_DISCONNECTED");
@@ -65,7 +83,7 @@ void HTTPClient::init(string url) {
     config.url = url.c_str();
     config.event_handler = http_event_handler;
     config.user_data = this;
-    config.timeout_ms = 1000;
+    config.timeout_ms = timeoutMs;
     config.disable_auto_redirect = true;
     client = esp_http_client_init(&config);
     if (client == nullptr) {
@@ -79,6 +97,12 @@ int HTTPClient::statusCode() {
     return esp_http_client_get_status_code(client);
 }
 
+void HTTPClient::setTimeout(int ms) {
+    if (ms == timeoutMs) return;
+    timeoutMs = ms;
+    if (client) esp_http_client_set_timeout_ms(client, ms);
+}
+
 void HTTPClient::clearBuffer() {
     if (!buffer && bufferSize) {
         buffer = new uint8_t[bufferSize];
@@ -99,13 +123,42 @@ void HTTPClient::clearBuffer() {
     bufferOverflow = false;
 }
 
+// Replaces the host of the url with its cached address, keeping the original authority for the Host header.
+static bool resolveUrl(string &url, string &authority) {
+    size_t hostBegin = url.find("://");
+    if (hostBegin == string::npos) return false;
+    hostBegin += 3;
+    size_t authorityEnd = url.find('/', hostBegin);
+    if (authorityEnd == string::npos) authorityEnd = url.size();
+    size_t hostEnd = url.find(':', hostBegin);
+    if (hostEnd == string::npos || hostEnd > authorityEnd) hostEnd = authorityEnd;
+
+    string host = url.substr(hostBegin, hostEnd - hostBegin), address;
+    if (!resolve(host, address)) return false;
+    authority = url.substr(hostBegin, authorityEnd - hostBegin);
+    url.replace(hostBegin, hostEnd - hostBegin, address);
+    return true;
+}
+
 bool HTTPClient::get(string url, int redirect) {
+    TRACE_SCOPE("http get");
+    string authority;
+    bool resolved = resolveUrl(url, authority);
     init(url);
+    if (resolved) esp_http_client_set_header(client, "Host", authority.c_str());
     esp_http_client_set_method(client, HTTP_METHOD_GET);
     while (true) {
         clearBuffer();
+        timing = {};
+        timing.start = esp_timer_get_time();
+        expired = false;
         esp_err_t err = esp_http_client_perform(client);
-        if (err != ESP_OK) return false;
+        if (expired || cancelled) err = ESP_ERR_TIMEOUT; // the response is incomplete
+        if (stats) stats->record(timing, received, err == ESP_OK);
+        if (err != ESP_OK) {
+            if (resolved && err == ESP_ERR_HTTP_CONNECT) invalidateAddress(authority.substr(0, authority.find(':')));
+            return false;
+        }
         int code = statusCode();
         if (!(redirect--) || code / 10 != 30) return true; // not redirect
         esp_http_client_set_redirection(client);
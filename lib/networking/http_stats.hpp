@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+
+namespace Networking {
+
+// Fixed-bucket latency histogram in milliseconds.
+struct LatencyHistogram {
+    static constexpr int bucketCount = 10;
+    static constexpr int bucketLimits[bucketCount - 1] = { 10, 20, 50, 100, 200, 300, 500, 1000, 2000 };
+    uint32_t buckets[bucketCount] = {};
+    uint32_t count = 0;
+    uint32_t sum = 0;
+    uint32_t max = 0;
+
+    void add(uint32_t ms) {
+        int i = 0;
+        while (i < bucketCount - 1 && ms > (uint32_t)bucketLimits[i]) i++;
+        buckets[i]++;
+        count++;
+        sum += ms;
+        if (ms > max) max = ms;
+    }
+    uint32_t average() const {
+        return count ? sum / count : 0;
+    }
+    // Upper limit of the bucket containing the given percentile, max for the overflow bucket.
+    uint32_t percentile(int percent) const {
+        if (!count) return 0;
+        uint32_t threshold = (count * percent + 99) / 100, total = 0;
+        for (int i = 0; i < bucketCount - 1; i++) {
+            total += buckets[i];
+            if (total >= threshold) return bucketLimits[i];
+        }
+        return max;
+    }
+};
+
+class HTTPStats {
+public:
+    enum Phase {
+        Connect,   // request start to connected (includes DNS), 0 when the connection was reused
+        Request,   // connected to request header sent
+        FirstByte, // request header sent to first response header
+        Transfer,  // first response header to finish
+        Total,
+        PhaseCount,
+    };
+    static constexpr const char *phaseNames[PhaseCount] = { "connect", "request", "ttfb", "transfer", "total" };
+
+    struct Timing {
+        int64_t start = 0;
+        int64_t connected = 0;
+        int64_t headerSent = 0;
+        int64_t firstByte = 0;
+        int64_t finish = 0;
+    };
+
+    uint32_t requests = 0;
+    uint32_t errors = 0;
+    uint64_t bytes = 0;
+
+    const LatencyHistogram &phase(Phase phase) const {
+        return histograms[phase];
+    }
+
+    void record(const Timing &timing, int received, bool success) {
+        requests++;
+        bytes += received;
+        if (!success) {
+            errors++;
+            return;
+        }
+        int64_t connected = timing.connected ? timing.connected : timing.start;
+        int64_t headerSent = timing.headerSent ? timing.headerSent : connected;
+        int64_t firstByte = timing.firstByte ? timing.firstByte : headerSent;
+        int64_t finish = timing.finish ? timing.finish : firstByte;
+        histograms[Connect].add((connected - timing.start) / 1000);
+        histograms[Request].add((headerSent - connected) / 1000);
+        histograms[FirstByte].add((firstByte - headerSent) / 1000);
+        histograms[Transfer].add((finish - firstByte) / 1000);
+        histograms[Total].add((finish - timing.start) / 1000);
+    }
+
+    void print(const char *name) const {
+        printf("http %s: requests %u, errors %u, bytes %llu\n", name, (unsigned)requests, (unsigned)errors, (unsigned long long)bytes);
+        for (int i = 0; i < PhaseCount; i++) {
+            auto &histogram = histograms[i];
+            printf("  %-8s avg %4u p50 %4u p90 %4u max %4u |", phaseNames[i], (unsigned)histogram.average(),
+                (unsigned)histogram.percentile(50), (unsigned)histogram.percentile(90), (unsigned)histogram.max);
+            for (int j = 0; j < LatencyHistogram::bucketCount; j++) printf(" %u", (unsigned)histogram.buckets[j]);
+            printf("\n");
+        }
+    }
+
+private:
+    LatencyHistogram histograms[PhaseCount];
+};
+
+}
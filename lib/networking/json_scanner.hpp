@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "fixed_string.hpp"
+
+// Single-pass, allocation free JSON scanner. Values are reported as views into the source text,
+// so callers pick only the members they need without building a tree.
+namespace JSONScanner {
+
+enum class Type : uint8_t { String, Number, True, False, Null, Object, Array };
+
+struct Value {
+    Type type;
+    std::string_view raw; // string contents without quotes (still escaped), or the token text
+
+    bool isString() const { return type == Type::String; }
+    bool boolValue() const { return type == Type::True; }
+
+    // Unescapes a string value into out, clears out for any other type.
+    template<size_t N>
+    void stringValue(FixedString<N> &out) const {
+        out.clear();
+        if (!isString()) return;
+        const char *p = raw.data(), *end = p + raw.size();
+        while (p < end) {
+            const char *run = p;
+            while (p < end && *p != '\\') p++;
+            if (p > run && !appendRun(out, run, p - run)) return;
+            if (p >= end) return;
+            char encoded[4];
+            int size = unescape(p, end, encoded);
+            if (!out.append(encoded, size)) return;
+        }
+    }
+
+private:
+    template<size_t N>
+    static bool appendRun(FixedString<N> &out, const char *value, size_t size) {
+        if (out.append(value, size)) return true;
+        // keep the characters that fit
+        size_t fit = N - out.size();
+        while (fit > 0 && (value[fit] & 0xc0) == 0x80) fit--;
+        out.append(value, fit);
+        return false;
+    }
+    static int hex(const char *p, const char *end) {
+        if (end - p < 4) return -1;
+        int value = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = p[i];
+            value <<= 4;
+            if (c >= '0' && c <= '9') value |= c - '0';
+            else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+            else return -1;
+        }
+        return value;
+    }
+    static int utf8(uint32_t code, char *out) {
+        if (code < 0x80) { out[0] = code; return 1; }
+        if (code < 0x800) { out[0] = 0xc0 | (code >> 6); out[1] = 0x80 | (code & 0x3f); return 2; }
+        if (code < 0x10000) { out[0] = 0xe0 | (code >> 12); out[1] = 0x80 | ((code >> 6) & 0x3f); out[2] = 0x80 | (code & 0x3f); return 3; }
+        out[0] = 0xf0 | (code >> 18); out[1] = 0x80 | ((code >> 12) & 0x3f); out[2] = 0x80 | ((code >> 6) & 0x3f); out[3] = 0x80 | (code & 0x3f);
+        return 4;
+    }
+    // Decodes the escape sequence at p and advances p past it.
+    static int unescape(const char *&p, const char *end, char *out) {
+        if (end - p < 2) { p = end; return 0; }
+        char c = p[1];
+        p += 2;
+        switch (c) {
+        case 'b': out[0] = '\b'; return 1;
+        case 'f': out[0] = '\f'; return 1;
+        case 'n': out[0] = '\n'; return 1;
+        case 'r': out[0] = '\r'; return 1;
+        case 't': out[0] = '\t'; return 1;
+        case 'u': {
+            int code = hex(p, end);
+            if (code < 0) return 0;
+            p += 4;
+            if (code >= 0xd800 && code < 0xdc00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                int low = hex(p + 2, end);
+                if (low >= 0xdc00 && low < 0xe000) {
+                    p += 6;
+                    return utf8(0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00), out);
+                }
+            }
+            return utf8(code, out);
+        }
+        default: out[0] = c; return 1;
+        }
+    }
+};
+
+template<class F>
+class Scanner {
+private:
+    static constexpr int maxDepth = 16;
+    const char *p, *end;
+    F &member;
+
+    void skipWhitespace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    }
+    bool literal(std::string_view token) {
+        if ((size_t)(end - p) < token.size() || std::string_view(p, token.size()) != token) return false;
+        p += token.size();
+        return true;
+    }
+    bool string(std::string_view &out) {
+        if (p >= end || *p != '"') return false;
+        const char *begin = ++p;
+        while (p < end && *p != '"') {
+            if (*p == '\\') p++;
+            p++;
+        }
+        if (p >= end) return false;
+        out = std::string_view(begin, p - begin);
+        p++;
+        return true;
+    }
+    // Parses a value; members of objects up to visitDepth are reported to the callback.
+    bool value(Value &out, std::string_view key, int depth, int visitDepth) {
+        skipWhitespace();
+        if (p >= end) return false;
+        const char *begin = p;
+        switch (*p) {
+        case '"':
+            out.type = Type::String;
+            return string(out.raw);
+        case '{':
+            out.type = Type::Object;
+            if (!object(key, depth + 1, visitDepth)) return false;
+            break;
+        case '[':
+            out.type = Type::Array;
+            if (!array(depth + 1)) return false;
+            break;
+        case 't':
+            out.type = Type::True;
+            if (!literal("true")) return false;
+            break;
+        case 'f':
+            out.type = Type::False;
+            if (!literal("false")) return false;
+            break;
+        case 'n':
+            out.type = Type::Null;
+            if (!literal("null")) return false;
+            break;
+        default:
+            out.type = Type::Number;
+            while (p < end && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) p++;
+            if (p == begin) return false;
+            break;
+        }
+        out.raw = std::string_view(begin, p - begin);
+        return true;
+    }
+    bool object(std::string_view path, int depth, int visitDepth) {
+        if (depth > maxDepth) return false;
+        p++;
+        skipWhitespace();
+        if (p < end && *p == '}') { p++; return true; }
+        while (p < end) {
+            skipWhitespace();
+            std::string_view key;
+            if (!string(key)) return false;
+            skipWhitespace();
+            if (p >= end || *p != ':') return false;
+            p++;
+            Value item;
+            if (!value(item, key, depth, visitDepth)) return false;
+            if (depth <= visitDepth) member(path, key, item);
+            skipWhitespace();
+            if (p < end && *p == ',') { p++; continue; }
+            if (p < end && *p == '}') { p++; return true; }
+            return false;
+        }
+        return false;
+    }
+    bool array(int depth) {
+        if (depth > maxDepth) return false;
+        p++;
+        skipWhitespace();
+        if (p < end && *p == ']') { p++; return true; }
+        while (p < end) {
+            Value item;
+            if (!value(item, "", depth, 0)) return false;
+            skipWhitespace();
+            if (p < end && *p == ',') { p++; continue; }
+            if (p < end && *p == ']') { p++; return true; }
+            return false;
+        }
+        return false;
+    }
+
+public:
+    Scanner(const char *json, size_t length, F &member) : p(json), end(json + length), member(member) {}
+    bool scan(int visitDepth) {
+        skipWhitespace();
+        if (p >= end || *p != '{') return false;
+        return object("", 1, visitDepth);
+    }
+};
+
+// Calls member(path, key, value) for each member of the top level object and of the objects
+// directly nested in it, where path is the key of the enclosing member ("" at the top level).
+// Returns false for malformed input; members before the error have already been reported.
+template<class F>
+inline bool scan(const char *json, size_t length, F &&member) {
+    Scanner<F> scanner(json, length, member);
+    return scanner.scan(2);
+}
+
+}
@@ -6,6 +6,7 @@
 #define NETWORKING_IMPL_BEGIN namespace Networking {
 #define NETWORKING_IMPL_END }
 
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 #include <ctime>
@@ -17,6 +18,7 @@
 #include "esp_wifi.h"
 #include "esp_http_client.h"
 #include "types.hpp"
+#include "http_stats.hpp"
 
 NETWORKING_IMPL_BEGIN
 
@@ -37,12 +39,23 @@ bool isNetworkConnected();
 void waitNetworkConnect();
 bool startSntp();
 
+// Resolved address cache, kept across HTTPClient resets
+bool resolve(const string &host, string &address);
+void setStaticAddress(const string &host, const string &address);
+void invalidateAddress(const string &host);
+
 class HTTPClient : private NoMove {
 private:
     esp_http_client_handle_t client = nullptr;
     void init(string url);
 public:
+    HTTPStats *stats = nullptr;
+    HTTPStats::Timing timing;
     int received = 0;
+    int timeoutMs = 1000;   // each socket operation
+    int64_t deadline = 0;   // esp_timer usec for the whole request, 0 for none
+    bool expired = false;   // the last request was aborted at the deadline
+    std::atomic<bool> cancelled = false;
     uint8_t *buffer;
     int bufferSize = 0;
     bool bufferOverflow = false;
@@ -53,6 +66,9 @@ public:
     HTTPClient(int bufferSize) : bufferSize(bufferSize) {};
     ~HTTPClient();
     int statusCode();
+    void setTimeout(int ms);
+    void setDeadline(int64_t us) { deadline = us; }
+    void cancel() { cancelled = true; }
     void clearBuffer();
     bool get(string url, int redirect = 0);
     void reset();
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+// Null terminated string with inline storage. Longer values are truncated on a UTF-8 character boundary.
+template<size_t Capacity>
+class FixedString {
+private:
+    char buffer[Capacity + 1] = {};
+    size_t length = 0;
+
+public:
+    FixedString() = default;
+    FixedString(const char *value) { assign(value, strlen(value)); }
+
+    const char *c_str() const { return buffer; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    static constexpr size_t capacity() { return Capacity; }
+    operator std::string_view() const { return std::string_view(buffer, length); }
+
+    void clear() {
+        length = 0;
+        buffer[0] = '\0';
+    }
+    void assign(const char *value, size_t size) {
+        if (size > Capacity) {
+            size = Capacity;
+            while (size > 0 && (value[size] & 0xc0) == 0x80) size--;
+        }
+        memcpy(buffer, value, size);
+        length = size;
+        buffer[length] = '\0';
+    }
+    // Appends raw bytes, returns false if they did not fit.
+    bool append(const char *value, size_t size) {
+        if (length + size > Capacity) return false;
+        memcpy(buffer + length, value, size);
+        length += size;
+        buffer[length] = '\0';
+        return true;
+    }
+    FixedString &operator=(const char *value) {
+        assign(value, strlen(value));
+        return *this;
+    }
+
+    bool operator==(std::string_view other) const { return std::string_view(*this) == other; }
+    bool operator!=(std::string_view other) const { return std::string_view(*this) != other; }
+    bool operator==(const char *other) const { return std::string_view(*this) == other; }
+    bool operator!=(const char *other) const { return std::string_view(*this) != other; }
+    template<size_t N> bool operator==(const FixedString<N> &other) const { return std::string_view(*this) == std::string_view(other); }
+    template<size_t N> bool operator!=(const FixedString<N> &other) const { return std::string_view(*this) != std::string_view(other); }
+};
@@ -3,7 +3,14 @@
  */
 
 #pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
@@ -24,13 +31,174 @@ namespace RTOS {
         Realtime = configMAX_PRIORITIES - 1,
     };
 
+    // Callable stored in place when its capture fits Size bytes, otherwise in a heap copy.
+    template<size_t Size>
+    class InlineFunction : private NoMove {
+    private:
+        alignas(std::max_align_t) unsigned char storage[Size];
+        void (*invoker)(InlineFunction &) = nullptr;
+        void (*destroyer)(InlineFunction &) = nullptr;
+
+    public:
+        template<class F>
+        static constexpr bool fitsInline = sizeof(std::decay_t<F>) <= Size && alignof(std::decay_t<F>) <= alignof(std::max_align_t);
+
+        InlineFunction() = default;
+        ~InlineFunction() {
+            reset();
+        }
+
+        // Returns false if the callable did not fit and was copied to the heap.
+        template<class F>
+        bool assign(F &&func) {
+            using T = std::decay_t<F>;
+            static_assert(std::is_invocable_v<T &>, "callable must take no arguments");
+            reset();
+            if constexpr (fitsInline<F>) {
+                new (storage) T(std::forward<F>(func));
+                invoker = [](InlineFunction &f) { (*std::launder(reinterpret_cast<T *>(f.storage)))(); };
+                destroyer = [](InlineFunction &f) { std::launder(reinterpret_cast<T *>(f.storage))->~T(); };
+                return true;
+            } else {
+                *reinterpret_cast<T **>(storage) = new T(std::forward<F>(func));
+                invoker = [](InlineFunction &f) { (**reinterpret_cast<T **>(f.storage))(); };
+                destroyer = [](InlineFunction &f) { delete *reinterpret_cast<T **>(f.storage); };
+                return false;
+            }
+        }
+        void operator()() {
+            invoker(*this);
+        }
+        void reset() {
+            if (destroyer) destroyer(*this);
+            invoker = nullptr;
+            destroyer = nullptr;
+        }
+        explicit operator bool() const {
+            return invoker != nullptr;
+        }
+    };
+
+    // Fixed-capacity queue of callables. Each slot stores a capture of up to inlineSize bytes in place,
+    // so sending does not allocate; larger captures fall back to a heap copy and are counted.
+    // Slots are handed between tasks by index, since FreeRTOS queues copy items bytewise.
+    class MessageQueue : private NoMove {
+    public:
+        static constexpr size_t inlineSize = 64;
+        using Slot = InlineFunction<inlineSize>;
+
+    private:
+        Slot *slots;
+        UBaseType_t length;
+        QueueHandle_t messages;
+        QueueHandle_t freeSlots;
+        std::atomic<uint32_t> sent = 0;
+        std::atomic<uint32_t> fallbacks = 0;
+        std::atomic<UBaseType_t> highWater = 0;
+
+    public:
+        MessageQueue(UBaseType_t length) : length(length < 255 ? length : 255) {
+            length = this->length;
+            slots = new Slot[length];
+            messages = xQueueCreate(length, sizeof(uint8_t));
+            freeSlots = xQueueCreate(length, sizeof(uint8_t));
+            for (UBaseType_t i = 0; i < length; i++) {
+                uint8_t index = i;
+                xQueueSend(freeSlots, &index, 0);
+            }
+        }
+        ~MessageQueue() {
+            uint8_t index;
+            while (xQueueReceive(messages, &index, 0)) slots[index].reset();
+            vQueueDelete(messages);
+            vQueueDelete(freeSlots);
+            delete[] slots;
+        }
+
+        // Returns false if no slot became free within the wait time.
+        template<class F>
+        bool send(F &&func, TickType_t wait = portMAX_DELAY) {
+            static_assert(std::is_invocable_v<std::decay_t<F> &>, "message must be callable without arguments");
+            uint8_t index;
+            if (!xQueueReceive(freeSlots, &index, wait)) return false;
+            UBaseType_t used = length - uxQueueMessagesWaiting(freeSlots);
+            UBaseType_t peak = highWater;
+            while (used > peak && !highWater.compare_exchange_weak(peak, used));
+            if (!slots[index].assign(std::forward<F>(func))) fallbacks++;
+            sent++;
+            xQueueSend(messages, &index, portMAX_DELAY);
+            return true;
+        }
+        // Runs the next message, returns false if none arrived within the wait time.
+        bool receive(TickType_t wait) {
+            uint8_t index;
+            if (!xQueueReceive(messages, &index, wait)) return false;
+            auto &slot = slots[index];
+            slot();
+            slot.reset();
+            xQueueSend(freeSlots, &index, portMAX_DELAY);
+            return true;
+        }
+
+        void print(const char *name) const {
+            printf("queue %s: sent %u, high water %u/%u, heap fallbacks %u\n", name,
+                (unsigned)sent, (unsigned)highWater, (unsigned)length, (unsigned)fallbacks);
+        }
+    };
+
+    // Running tasks, for stack monitoring.
+    class TaskRegistry : private NoMove {
+    public:
+        struct Entry {
+            const char *name;
+            TaskHandle_t handle;
+            uint32_t stackSize; // bytes, 0 if unknown
+        };
+        static constexpr int capacity = 12;
+
+    private:
+        Entry entries[capacity] = {};
+        int count = 0;
+        portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+    public:
+        void add(const char *name, TaskHandle_t handle, uint32_t stackSize) {
+            portENTER_CRITICAL(&lock);
+            if (count < capacity) entries[count++] = { name, handle, stackSize };
+            portEXIT_CRITICAL(&lock);
+        }
+        void remove(TaskHandle_t handle) {
+            portENTER_CRITICAL(&lock);
+            for (int i = 0; i < count; i++) {
+                if (entries[i].handle != handle) continue;
+                entries[i] = entries[--count];
+                break;
+            }
+            portEXIT_CRITICAL(&lock);
+        }
+        // Copies the entries, returns the number copied.
+        int list(Entry *buffer, int size) {
+            portENTER_CRITICAL(&lock);
+            int copied = count < size ? count : size;
+            for (int i = 0; i < copied; i++) buffer[i] = entries[i];
+            portEXIT_CRITICAL(&lock);
+            return copied;
+        }
+    };
+    inline TaskRegistry &taskRegistry() {
+        static TaskRegistry registry;
+        return registry;
+    }
+
     template <TickType_t Cycle>
     class Task : private NoMove {
     private:
         const char *name;
         bool needTaskDelete = false;
         TaskHandle_t handle = nullptr;
-        QueueHandle_t queue = nullptr;
+        MessageQueue *queue = nullptr;
+        std::atomic<TickType_t> cycleTicks = Cycle;
+        uint32_t stackSize = 0;
     public:
         Task() {
             handle = xTaskGetCurrentTaskHandle();
@@ -38,33 +206,32 @@ namespace RTOS {
         }
         Task(const char *name) : name(name) {}
         ~Task() {
+            if (handle) taskRegistry().remove(handle);
             if (needTaskDelete) vTaskDelete(handle);
-            if (queue) vQueueDelete(queue);
+            delete queue;
         }
 
         void createQueue(UBaseType_t queueLength = 32) {
             if (queue) return;
-            queue = xQueueCreate(queueLength, sizeof(void *));
+            queue = new MessageQueue(queueLength);
         }
         void start(TaskPriority priority = TaskPriority::Normal, UBaseType_t stackDepth = 2048, BaseType_t core = 0) {
             needTaskDelete = true;
+            stackSize = stackDepth; // ESP-IDF counts stack depth in bytes
             xTaskCreatePinnedToCore([](void *arg) {
                 auto task = static_cast<Task *>(arg);
                 task->run();
             }, name, stackDepth, this, static_cast<UBaseType_t>(priority), &handle, core);
         }
         void run() {
+            if (!handle) handle = xTaskGetCurrentTaskHandle();
+            taskRegistry().add(name, handle, stackSize);
             init();
             while (true) {
-                void *msg;
                 if (queue) {
-                    if (xQueueReceive(queue, &msg, Cycle)) {
-                        auto func = static_cast<function<void()>*>(msg);
-                        (*func)();
-                        delete func;
-                    }
+                    queue->receive(cycleTicks);
                 } else {
-                    vTaskDelay(Cycle);
+                    vTaskDelay(cycleTicks);
                 }
                 cycle();
             }
@@ -72,13 +239,21 @@ namespace RTOS {
 
         virtual void init() {}
         virtual void cycle() {}
-        void send(function<void()> func, TickType_t wait = portMAX_DELAY) {
+        // Returns false if the queue stayed full for the wait time.
+        template<class F>
+        bool send(F &&func, TickType_t wait = portMAX_DELAY) {
             if (!queue) {
                 ESP_LOGE("RTOS::Task", "Task queue is not created.");
                 assert(0);
             }
-            void *msg = new function<void()>(func);
-            xQueueSend(queue, &msg, wait);
+            return queue->send(std::forward<F>(func), wait);
+        }
+        MessageQueue *messageQueue() {
+            return queue;
+        }
+        // Changes the cycle from the next wait on.
+        void setCycle(TickType_t ticks) {
+            cycleTicks = ticks;
         }
         bool isBlocked() {
             return handle && eTaskGetState(handle) == eBlocked;
@@ -92,16 +267,6 @@ namespace RTOS {
         vTaskDelay(pdMS_TO_TICKS(ms));
     }
 
-    inline void timeout(int ms, function<void()> func) {
-        TimerHandle_t timer = xTimerCreate("timeout", pdMS_TO_TICKS(ms), pdFALSE, new function<void()>(func), [](TimerHandle_t timer) {
-            auto func = static_cast<function<void()>*>(pvTimerGetTimerID(timer));
-            (*func)();
-            delete func;
-            xTimerDelete(timer, 0);
-        });
-        xTimerStart(timer, 0);
-    }
-
     class Semaphore {
     private:
         SemaphoreHandle_t handle;
@@ -134,11 +299,303 @@ namespace RTOS {
         inline void give() {
             xSemaphoreGive(this->handle);
         }
-        inline void take(TickType_t ticks = portMAX_DELAY) {
-            xSemaphoreTake(this->handle, ticks);
+        inline bool take(TickType_t ticks = portMAX_DELAY) {
+            return xSemaphoreTake(this->handle, ticks) == pdTRUE;
+        }
+    };
+
+    struct TimerId {
+        uint16_t index = UINT16_MAX;
+        uint16_t generation = 0;
+        explicit operator bool() const { return index != UINT16_MAX; }
+    };
+
+    // Hierarchical timer wheel running timeouts and periodic callbacks on one task. Timers live in
+    // preallocated slots linked into per-tick buckets, so scheduling and cancelling are O(1); the
+    // upper levels are cascaded into the lower ones as time reaches them.
+    // The task sleeps until the earliest timer is due and is woken through its queue when a timer
+    // changes that, so an idle wheel does not wake the CPU every tick, only every maxTicks.
+    // Callbacks run on the timer task and should hand longer work to another task.
+    class TimerWheel : private NoMove {
+    public:
+        static constexpr int tickMs = 10;
+        static constexpr int levelBits = 6;
+        static constexpr int levelSize = 1 << levelBits;
+        static constexpr int levelCount = 3;
+        static constexpr uint32_t maxTicks = (1u << (levelBits * levelCount)) - 1; // about 43 minutes
+        static constexpr int capacity = 32;
+        static constexpr size_t inlineSize = 32;
+
+    private:
+        static constexpr uint32_t mask = levelSize - 1;
+        enum class State : uint8_t { Free, Pending, Running, Cancelled };
+        struct Timer {
+            InlineFunction<inlineSize> func;
+            uint32_t expires = 0;
+            uint32_t period = 0; // ticks, 0 for one-shot
+            int16_t prev = -1;
+            int16_t next = -1;
+            int16_t bucket = -1;
+            uint16_t generation = 0;
+            State state = State::Free;
+        };
+        class WheelTask : public Task<portMAX_DELAY> {
+            TimerWheel &wheel;
+        public:
+            WheelTask(TimerWheel &wheel) : Task("timer"), wheel(wheel) {}
+            virtual void cycle() override { setCycle(wheel.advance()); }
+        };
+
+        Timer timers[capacity];
+        int16_t buckets[levelCount * levelSize];
+        int16_t freeList = 0;
+        uint32_t current;
+        Semaphore mutex = Semaphore::mutex();
+        WheelTask *task = nullptr;
+        uint32_t wakeAt = 0; // tick the task sleeps until
+        bool sleeping = true; // no timer pending when the task went to sleep
+        uint32_t scheduled = 0, fired = 0, overflows = 0, fallbacks = 0, wakeups = 0;
+        int active = 0, highWater = 0;
+        // RTOS ticks counted in 64 bits from the deltas of the tick count, which wraps around after
+        // about 50 days. Wheel ticks wrap modulo 2^32 and are only compared by signed differences.
+        portMUX_TYPE clockLock = portMUX_INITIALIZER_UNLOCKED;
+        TickType_t lastTickCount = xTaskGetTickCount();
+        uint64_t elapsedTicks = lastTickCount;
+
+        // Must be called at least once per wrap of the tick count, the task wakes every maxTicks for that.
+        uint32_t now() {
+            portENTER_CRITICAL(&clockLock);
+            TickType_t count = xTaskGetTickCount();
+            elapsedTicks += (TickType_t)(count - lastTickCount);
+            lastTickCount = count;
+            uint32_t value = (uint32_t)(elapsedTicks * portTICK_PERIOD_MS / tickMs);
+            portEXIT_CRITICAL(&clockLock);
+            return value;
+        }
+        static uint32_t ticks(int ms) {
+            uint32_t value = ms <= 0 ? 1 : (ms + tickMs - 1) / tickMs;
+            return value > maxTicks ? maxTicks : value;
+        }
+
+        void link(int16_t index) {
+            auto &timer = timers[index];
+            uint32_t delta = timer.expires - current;
+            int bucket;
+            if (delta < (1u << levelBits)) bucket = timer.expires & mask;
+            else if (delta < (1u << (levelBits * 2))) bucket = levelSize + ((timer.expires >> levelBits) & mask);
+            else bucket = levelSize * 2 + ((timer.expires >> (levelBits * 2)) & mask);
+            timer.bucket = bucket;
+            timer.prev = -1;
+            timer.next = buckets[bucket];
+            if (timer.next >= 0) timers[timer.next].prev = index;
+            buckets[bucket] = index;
+        }
+        void unlink(int16_t index) {
+            auto &timer = timers[index];
+            if (timer.prev >= 0) timers[timer.prev].next = timer.next;
+            else buckets[timer.bucket] = timer.next;
+            if (timer.next >= 0) timers[timer.next].prev = timer.prev;
+            timer.prev = timer.next = timer.bucket = -1;
+        }
+        void release(int16_t index) {
+            auto &timer = timers[index];
+            timer.func.reset();
+            timer.state = State::Free;
+            timer.generation++;
+            timer.next = freeList;
+            freeList = index;
+            active--;
+        }
+        void cascade(int bucket) {
+            int16_t index = buckets[bucket];
+            buckets[bucket] = -1;
+            while (index >= 0) {
+                int16_t next = timers[index].next;
+                link(index);
+                index = next;
+            }
+        }
+
+        // Earliest expiry of the pending timers, to be called with the mutex held.
+        bool nextExpiry(uint32_t &expires) const {
+            bool found = false;
+            for (auto &timer : timers) {
+                if (timer.state != State::Pending) continue;
+                if (!found || (int32_t)(timer.expires - expires) < 0) expires = timer.expires;
+                found = true;
+            }
+            return found;
+        }
+        // Moves the wheel to tick without visiting the ticks before it, nothing may expire until then.
+        // The pending timers are linked again, since the cascades of the skipped ticks did not run.
+        void skipTo(uint32_t tick) {
+            current = tick;
+            for (auto &bucket : buckets) bucket = -1;
+            for (int16_t i = 0; i < capacity; i++) {
+                if (timers[i].state == State::Pending) link(i);
+            }
+        }
+        // Wakes the task if the timer is due before the task planned to wake, to be called with the mutex held.
+        bool shouldWake(uint32_t expires) const {
+            return task && (sleeping || (int32_t)(expires - wakeAt) < 0);
+        }
+        void wake() {
+            task->send([]() {}, 0); // fails only if a wake up is already queued
+        }
+
+        // Runs the timers due by now, returns the RTOS ticks until the next one is due.
+        TickType_t advance() {
+            uint32_t target = now();
+            int16_t expired[capacity];
+            wakeups++;
+            mutex.take();
+            uint32_t next = 0, until = target;
+            if (nextExpiry(next) && (int32_t)(next - until) < 0) until = next;
+            if ((int32_t)(until - 1 - current) > 0) skipTo(until - 1);
+            mutex.give();
+            while (true) {
+                int count = 0;
+                mutex.take();
+                if ((int32_t)(target - current) <= 0) {
+                    sleeping = !nextExpiry(next);
+                    wakeAt = next;
+                    mutex.give();
+                    if (sleeping) return pdMS_TO_TICKS(maxTicks * tickMs); // only to keep the clock
+                    int32_t remaining = next - now();
+                    return remaining > 0 ? pdMS_TO_TICKS(remaining * tickMs) : 0;
+                }
+                current++;
+                if ((current & mask) == 0) {
+                    uint32_t upper = (current >> levelBits) & mask;
+                    if (upper == 0) cascade(levelSize * 2 + ((current >> (levelBits * 2)) & mask));
+                    cascade(levelSize + upper);
+                }
+                int bucket = current & mask;
+                for (int16_t index = buckets[bucket]; index >= 0; index = timers[index].next) {
+                    timers[index].state = State::Running;
+                    expired[count++] = index;
+                }
+                buckets[bucket] = -1;
+                mutex.give();
+
+                for (int i = 0; i < count; i++) {
+                    timers[expired[i]].func();
+                    fired++;
+                }
+
+                if (count == 0) continue;
+                mutex.take();
+                for (int i = 0; i < count; i++) {
+                    auto &timer = timers[expired[i]];
+                    if (timer.state == State::Running && timer.period) {
+                        timer.state = State::Pending;
+                        timer.expires = current + timer.period;
+                        link(expired[i]);
+                    } else {
+                        release(expired[i]);
+                    }
+                }
+                mutex.give();
+            }
+        }
+
+    public:
+        TimerWheel() {
+            for (int i = 0; i < capacity; i++) timers[i].next = i + 1 < capacity ? i + 1 : -1;
+            for (auto &bucket : buckets) bucket = -1;
+            current = now();
+        }
+
+        // Calls func after delayMs, then every periodMs if it is not 0.
+        // Returns an invalid id if all slots are in use.
+        template<class F>
+        TimerId schedule(int delayMs, int periodMs, F &&func) {
+            mutex.take();
+            if (!task) {
+                task = new WheelTask(*this);
+                task->createQueue(2);
+                task->start(TaskPriority::High, 1024 * 3, 0);
+            }
+            if (freeList < 0) {
+                overflows++;
+                mutex.give();
+                ESP_LOGE("RTOS::TimerWheel", "No free timer slot.");
+                return TimerId();
+            }
+            int16_t index = freeList;
+            auto &timer = timers[index];
+            freeList = timer.next;
+            if (!timer.func.assign(std::forward<F>(func))) fallbacks++;
+            timer.expires = now() + ticks(delayMs);
+            if ((int32_t)(timer.expires - current) <= 0) timer.expires = current + 1;
+            timer.period = periodMs > 0 ? ticks(periodMs) : 0;
+            timer.state = State::Pending;
+            link(index);
+            scheduled++;
+            if (++active > highWater) highWater = active;
+            TimerId id = { (uint16_t)index, timer.generation };
+            bool shouldWake = this->shouldWake(timer.expires);
+            mutex.give();
+            if (shouldWake) wake();
+            return id;
+        }
+
+        // Returns false if the timer already fired (one-shot) or was cancelled.
+        bool cancel(TimerId id) {
+            if (!id || id.index >= capacity) return false;
+            mutex.take();
+            auto &timer = timers[id.index];
+            bool found = timer.generation == id.generation && (timer.state == State::Pending || timer.state == State::Running);
+            bool shouldWake = false;
+            if (found && timer.state == State::Pending) {
+                shouldWake = task && timer.expires == wakeAt; // the task can sleep longer
+                unlink(id.index);
+                release(id.index);
+            } else if (found) {
+                timer.state = State::Cancelled; // released once the callback returns
+            }
+            mutex.give();
+            if (shouldWake) wake();
+            return found;
+        }
+
+        bool isPending(TimerId id) {
+            if (!id || id.index >= capacity) return false;
+            mutex.take();
+            auto &timer = timers[id.index];
+            bool pending = timer.generation == id.generation && (timer.state == State::Pending || timer.state == State::Running);
+            mutex.give();
+            return pending;
+        }
+
+        uint32_t wakeupCount() const {
+            return wakeups;
+        }
+
+        void print() {
+            printf("timer wheel: scheduled %u, fired %u, wakeups %u, active %d, high water %d/%d, overflows %u, heap fallbacks %u\n",
+                (unsigned)scheduled, (unsigned)fired, (unsigned)wakeups, active, highWater, capacity, (unsigned)overflows, (unsigned)fallbacks);
         }
     };
 
+    inline TimerWheel &timerWheel() {
+        static TimerWheel wheel;
+        return wheel;
+    }
+    template<class F>
+    inline TimerId timeout(int ms, F &&func) {
+        return timerWheel().schedule(ms, 0, std::forward<F>(func));
+    }
+    template<class F>
+    inline TimerId interval(int ms, F &&func) {
+        return timerWheel().schedule(ms, ms, std::forward<F>(func));
+    }
+    inline bool cancel(TimerId &id) {
+        bool cancelled = timerWheel().cancel(id);
+        id = TimerId();
+        return cancelled;
+    }
+
     template<class T>
     class EventGroup {
     private:
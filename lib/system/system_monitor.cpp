@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "system_monitor.hpp"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char *TAG = "SystemMonitor";
+
+// Allocations through operator new. C components allocate with malloc directly and are not counted.
+static std::atomic<uint32_t> allocationCount = 0;
+
+static void *allocate(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+void *operator new(size_t size) {
+    void *ptr = allocate(size);
+    if (!ptr) abort();
+    return ptr;
+}
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return allocate(size);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return allocate(size);
+}
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+void operator delete[](void *ptr) noexcept {
+    free(ptr);
+}
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+void operator delete[](void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+namespace SystemMonitor {
+
+static uint32_t stackWarning = 0, heapWarning = 0;
+static uint32_t cycleStart = 0;
+static AllocationStats allocations = {};
+static uint32_t heapWarned = UINT32_MAX;
+struct StackWarning {
+    TaskHandle_t handle;
+    uint32_t warned;
+};
+static StackWarning stackWarned[RTOS::TaskRegistry::capacity] = {};
+
+void setWarningThresholds(uint32_t stackBytes, uint32_t heapBytes) {
+    stackWarning = stackBytes;
+    heapWarning = heapBytes;
+}
+
+static HeapStats heapStats() {
+    return {
+        .free = (uint32_t)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+        .minimumFree = (uint32_t)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+        .largestBlock = (uint32_t)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+    };
+}
+
+Snapshot sample() {
+    Snapshot snapshot;
+    RTOS::TaskRegistry::Entry entries[RTOS::TaskRegistry::capacity];
+    snapshot.taskCount = RTOS::taskRegistry().list(entries, RTOS::TaskRegistry::capacity);
+    for (int i = 0; i < snapshot.taskCount; i++) {
+        snapshot.tasks[i] = {
+            .name = entries[i].name,
+            .stackSize = entries[i].stackSize,
+            .stackFree = (uint32_t)uxTaskGetStackHighWaterMark(entries[i].handle), // bytes on ESP-IDF
+        };
+    }
+    snapshot.heap = heapStats();
+    snapshot.allocations = allocations;
+    snapshot.allocations.total = allocationCount;
+    return snapshot;
+}
+
+// Warns once per new low below the threshold.
+static void checkThresholds() {
+    if (stackWarning) {
+        RTOS::TaskRegistry::Entry entries[RTOS::TaskRegistry::capacity];
+        int count = RTOS::taskRegistry().list(entries, RTOS::TaskRegistry::capacity);
+        for (int i = 0; i < count; i++) {
+            uint32_t free = uxTaskGetStackHighWaterMark(entries[i].handle);
+            if (free >= stackWarning) continue;
+            StackWarning *warning = nullptr;
+            for (auto &item : stackWarned) {
+                if (item.handle == entries[i].handle) warning = &item;
+                if (!warning && !item.handle) warning = &item;
+            }
+            if (!warning) continue;
+            if (warning->handle == entries[i].handle && free >= warning->warned) continue;
+            *warning = { entries[i].handle, free };
+            ESP_LOGW(TAG, "task %s: %u bytes of stack left", entries[i].name, (unsigned)free);
+        }
+    }
+    if (heapWarning) {
+        uint32_t minimumFree = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+        if (minimumFree < heapWarning && minimumFree < heapWarned) {
+            heapWarned = minimumFree;
+            ESP_LOGW(TAG, "minimum free heap %u bytes, largest block %u bytes", (unsigned)minimumFree,
+                (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+        }
+    }
+}
+
+void cycle() {
+    uint32_t total = allocationCount;
+    if (cycleStart) {
+        allocations.lastCycle = total - cycleStart;
+        if (allocations.lastCycle > allocations.maxCycle) allocations.maxCycle = allocations.lastCycle;
+    }
+    cycleStart = total;
+    checkThresholds();
+}
+
+void print() {
+    auto snapshot = sample();
+    printf("heap: free %u, minimum free %u, largest block %u\n", (unsigned)snapshot.heap.free,
+        (unsigned)snapshot.heap.minimumFree, (unsigned)snapshot.heap.largestBlock);
+    printf("allocations: total %u, last cycle %u, max cycle %u\n", (unsigned)snapshot.allocations.total,
+        (unsigned)snapshot.allocations.lastCycle, (unsigned)snapshot.allocations.maxCycle);
+    for (int i = 0; i < snapshot.taskCount; i++) {
+        auto &task = snapshot.tasks[i];
+        if (task.stackSize) {
+            printf("  %-10s stack free %5u / %5u%s\n", task.name, (unsigned)task.stackFree, (unsigned)task.stackSize,
+                stackWarning && task.stackFree < stackWarning ? " (low)" : "");
+        } else {
+            printf("  %-10s stack free %5u%s\n", task.name, (unsigned)task.stackFree,
+                stackWarning && task.stackFree < stackWarning ? " (low)" : "");
+        }
+    }
+}
+
+}
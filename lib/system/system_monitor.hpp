@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <cstdint>
+#include "rtos.hpp"
+
+// Stack high-water marks of the registered RTOS::Tasks, heap levels and allocation counts.
+namespace SystemMonitor {
+
+struct TaskStats {
+    const char *name;
+    uint32_t stackSize; // bytes, 0 if unknown
+    uint32_t stackFree; // bytes never used since the task started
+};
+
+struct HeapStats {
+    uint32_t free;
+    uint32_t minimumFree; // since boot
+    uint32_t largestBlock;
+};
+
+struct AllocationStats {
+    uint32_t total;     // since boot
+    uint32_t lastCycle; // during the last update cycle
+    uint32_t maxCycle;
+};
+
+struct Snapshot {
+    TaskStats tasks[RTOS::TaskRegistry::capacity];
+    int taskCount;
+    HeapStats heap;
+    AllocationStats allocations;
+};
+
+// Warnings are logged once a task's free stack or the minimum free heap drops below these, 0 disables.
+void setWarningThresholds(uint32_t stackBytes, uint32_t heapBytes);
+// Marks the start of an update cycle, closes the allocation count of the previous one and checks the thresholds.
+void cycle();
+Snapshot sample();
+void print();
+
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+
+// Begin/end markers for latency tracing, dumped over serial as Chrome trace_event JSON
+// (open it in chrome://tracing or Perfetto). Build with -DKYOSHIN_TRACE to enable, otherwise
+// the macros compile to nothing. Names must be string literals, only the pointer is recorded.
+#ifdef KYOSHIN_TRACE
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#else
+#include <chrono>
+#endif
+
+namespace Trace {
+
+#ifdef KYOSHIN_TRACE_CAPACITY
+inline constexpr uint32_t capacity = KYOSHIN_TRACE_CAPACITY;
+#else
+inline constexpr uint32_t capacity = 256; // events per core
+#endif
+static_assert((capacity & (capacity - 1)) == 0, "trace capacity must be a power of 2");
+#ifdef ESP_PLATFORM
+inline constexpr int coreCount = portNUM_PROCESSORS;
+#else
+inline constexpr int coreCount = 1;
+#endif
+
+struct Event {
+    std::atomic<uint32_t> sequence = 0; // index + 1 once the event is complete
+    const char *name;
+    const void *thread;
+    uint32_t time; // usec
+    char phase;
+};
+// Writers claim slots with an atomic increment, so recording takes no lock. When the ring is
+// full the oldest events are overwritten.
+struct Ring {
+    std::atomic<uint32_t> head = 0;
+    Event events[capacity];
+};
+inline Ring rings[coreCount];
+
+#ifdef ESP_PLATFORM
+inline uint32_t now() { return (uint32_t)esp_timer_get_time(); }
+inline const void *currentThread() { return xTaskGetCurrentTaskHandle(); }
+inline int currentCore() { return xPortGetCoreID(); }
+inline const char *threadName(const void *thread) { return pcTaskGetName((TaskHandle_t)thread); }
+#else
+inline uint32_t now() {
+    static const auto start = std::chrono::steady_clock::now();
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+inline const void *currentThread() {
+    static thread_local char marker;
+    return &marker;
+}
+inline int currentCore() { return 0; }
+inline const char *threadName(const void *) { return nullptr; }
+#endif
+
+inline void record(const char *name, char phase) {
+    auto &ring = rings[currentCore()];
+    uint32_t index = ring.head.fetch_add(1, std::memory_order_relaxed);
+    auto &event = ring.events[index & (capacity - 1)];
+    event.sequence.store(0, std::memory_order_relaxed);
+    event.name = name;
+    event.thread = currentThread();
+    event.time = now();
+    event.phase = phase;
+    event.sequence.store(index + 1, std::memory_order_release);
+}
+
+class Scope {
+    const char *name;
+public:
+    Scope(const char *name) : name(name) { record(name, 'B'); }
+    ~Scope() { record(name, 'E'); }
+};
+
+// Prints the recorded events. Recording continues meanwhile, events overwritten while they are
+// read are skipped.
+inline void dump() {
+    constexpr int maxThreads = 16;
+    const void *threads[maxThreads];
+    int threadCount = 0;
+    auto threadId = [&](const void *thread) {
+        for (int i = 0; i < threadCount; i++) if (threads[i] == thread) return i;
+        if (threadCount == maxThreads) return maxThreads;
+        threads[threadCount] = thread;
+        return threadCount++;
+    };
+
+    const char *separator = "";
+    printf("{\"traceEvents\":[\n");
+    for (auto &ring : rings) {
+        uint32_t head = ring.head.load(std::memory_order_acquire);
+        for (uint32_t index = head > capacity ? head - capacity : 0; index < head; index++) {
+            auto &event = ring.events[index & (capacity - 1)];
+            if (event.sequence.load(std::memory_order_acquire) != index + 1) continue;
+            const char *name = event.name;
+            const void *thread = event.thread;
+            uint32_t time = event.time;
+            char phase = event.phase;
+            if (event.sequence.load(std::memory_order_acquire) != index + 1) continue;
+            printf("%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%u,\"pid\":1,\"tid\":%d}", separator, name, phase, (unsigned)time, threadId(thread));
+            separator = ",\n";
+        }
+    }
+    for (int i = 0; i < threadCount; i++) {
+        const char *name = threadName(threads[i]);
+        if (name) printf("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", separator, i, name);
+        else printf("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}", separator, i, i);
+        separator = ",\n";
+    }
+    printf("\n]}\n");
+}
+
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_BEGIN(name) Trace::record(name, 'B')
+#define TRACE_END(name) Trace::record(name, 'E')
+#define TRACE_DUMP() Trace::dump()
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name) ((void)0)
+#define TRACE_DUMP() ((void)0)
+
+#endif
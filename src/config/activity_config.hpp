@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include "config_internal.hpp"
+
+DEF_CONFIG_ENUM(ActivityState, Active, Quiet, Dormant);
+struct ActivityStateConfig {
+    const char *identifier;
+    int quietAfter;     // sec without activity before the state is entered
+    int updateInterval; // sec between realtime image updates
+    int frameInterval;  // msec between UI task cycles
+};
+inline constexpr ActivityStateConfig ACTIVITY_STATE_CONFIG[ActivityState::count] = {
+    { "active" , 0  , 1 , 33  },
+    { "quiet"  , 10 , 5 , 33  },
+    { "dormant", 120, 10, 100 },
+};
+inline const char *identifier(ActivityState value) {
+    return ACTIVITY_STATE_CONFIG[value.value].identifier;
+}
+
+// Coarse intensity of a realtime image pixel from its RGB332 color, following the kmoni color
+// scale: 0 blue (below ~1), 1 green (~1-2), 2 yellow (~3), 3 orange (~4), 4 red (5 and above).
+inline constexpr uint8_t intensityLevel(uint8_t color) {
+    int r = color >> 5, g = (color >> 2) & 0b111, b = color & 0b11;
+    if (r < 4) return g >= 4 && b < 2 ? 1 : 0;
+    if (g >= 4 && b >= 2) return 0; // white and light gray
+    if (g >= 6) return 2;
+    if (g >= 3) return 3;
+    return 4;
+}
+struct IntensityLevelTable {
+    uint8_t level[256];
+    constexpr IntensityLevelTable() : level() {
+        for (int i = 0; i < 256; i++) level[i] = intensityLevel(i);
+    }
+};
+inline constexpr IntensityLevelTable INTENSITY_LEVEL_TABLE;
+inline constexpr int ACTIVE_INTENSITY_LEVEL = 2; // pixels at this level or above count as activity
+inline constexpr int ACTIVE_INTENSITY_PIXELS = 2; // needed in one image, a single pixel may be noise
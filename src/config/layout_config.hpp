@@ -19,6 +19,34 @@ inline constexpr ViewLayoutConfig VIEW_LAYOUT_CONFIG[ViewLayout::count] = {
     { FlashImg::MapBase16bitSwap240x320 , 240 , 320 , 2 , false },
     { FlashImg::MapBase16bitSwap212x240 , 212 , 240 , 1 , true  },
 };
+inline constexpr int WAVE_FRONT_FRAME_INTERVAL = 200; // msec, redraw interval while P/S-wave fronts are shown
+
+// Zoom levels of the map viewport against the fitted layout, the first one shows the whole map.
+inline constexpr uint8_t MAP_ZOOM_LEVELS[] = { 1, 2, 3, 4 };
+inline constexpr int MAP_ZOOM_LEVEL_COUNT = sizeof(MAP_ZOOM_LEVELS) / sizeof(MAP_ZOOM_LEVELS[0]);
+inline constexpr int MAP_PAN_DIVISION = 4; // a pan moves the view by this part of its size
+// Zoomed base maps are resampled in tiles kept in RAM, least recently used first out.
+inline constexpr int MAP_TILE_WIDTH = 40, MAP_TILE_HEIGHT = 20, MAP_TILE_CAPACITY = 16;
+// The last decoded overlay is kept run length encoded to show a new view without fetching again,
+// overlays that do not fit wait for the next update.
+inline constexpr int KEPT_OVERLAY_CAPACITY = 24 * 1024;
+
+// Interpolation of the realtime image between two seconds, the last frame shows the new second.
+DEF_CONFIG_ENUM(TweenMode, Off, Light, Smooth);
+struct TweenModeConfig {
+    const char *displayString;
+    uint8_t frames;
+    uint8_t fps;
+};
+inline constexpr TweenModeConfig TWEEN_MODE_CONFIG[TweenMode::count] = {
+    { "オフ"    , 1, 1  },
+    { "軽量"    , 4, 8  },
+    { "なめらか", 8, 15 },
+};
+inline const char *displayString(TweenMode value) {
+    return TWEEN_MODE_CONFIG[value.value].displayString;
+}
+inline constexpr int TWEEN_PIXEL_CAPACITY = 2048; // changed pixels per second, more are shown without interpolation
 
 DEF_CONFIG_ENUM(ViewLayoutMode, AutoHorizontal, ZoomHorizontal, ZoomVertical, HorizontalInfo);
 struct ViewLayoutModeConfig {
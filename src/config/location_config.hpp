@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include "config_internal.hpp"
+
+// Home location presets for the S-wave arrival countdown, at the prefectural offices.
+struct HomeLocationConfig {
+    const char *displayString;
+    float latitude;
+    float longitude;
+};
+inline constexpr HomeLocationConfig HOME_LOCATION_CONFIG[] = {
+    { "設定しない"       ,  0.000f ,   0.000f },
+    { "北海道(札幌市)"   , 43.064f , 141.347f },
+    { "青森県(青森市)"   , 40.824f , 140.740f },
+    { "岩手県(盛岡市)"   , 39.704f , 141.153f },
+    { "宮城県(仙台市)"   , 38.269f , 140.872f },
+    { "秋田県(秋田市)"   , 39.719f , 140.102f },
+    { "山形県(山形市)"   , 38.240f , 140.364f },
+    { "福島県(福島市)"   , 37.750f , 140.468f },
+    { "茨城県(水戸市)"   , 36.342f , 140.447f },
+    { "栃木県(宇都宮市)" , 36.566f , 139.884f },
+    { "群馬県(前橋市)"   , 36.391f , 139.061f },
+    { "埼玉県(さいたま市)", 35.857f , 139.649f },
+    { "千葉県(千葉市)"   , 35.605f , 140.123f },
+    { "東京都(新宿区)"   , 35.690f , 139.692f },
+    { "神奈川県(横浜市)" , 35.448f , 139.643f },
+    { "新潟県(新潟市)"   , 37.902f , 139.023f },
+    { "富山県(富山市)"   , 36.695f , 137.211f },
+    { "石川県(金沢市)"   , 36.594f , 136.626f },
+    { "福井県(福井市)"   , 36.065f , 136.222f },
+    { "山梨県(甲府市)"   , 35.664f , 138.568f },
+    { "長野県(長野市)"   , 36.651f , 138.181f },
+    { "岐阜県(岐阜市)"   , 35.391f , 136.722f },
+    { "静岡県(静岡市)"   , 34.977f , 138.383f },
+    { "愛知県(名古屋市)" , 35.180f , 136.907f },
+    { "三重県(津市)"     , 34.730f , 136.509f },
+    { "滋賀県(大津市)"   , 35.004f , 135.868f },
+    { "京都府(京都市)"   , 35.021f , 135.756f },
+    { "大阪府(大阪市)"   , 34.686f , 135.520f },
+    { "兵庫県(神戸市)"   , 34.691f , 135.183f },
+    { "奈良県(奈良市)"   , 34.686f , 135.833f },
+    { "和歌山県(和歌山市)", 34.226f , 135.168f },
+    { "鳥取県(鳥取市)"   , 35.504f , 134.238f },
+    { "島根県(松江市)"   , 35.472f , 133.051f },
+    { "岡山県(岡山市)"   , 34.662f , 133.935f },
+    { "広島県(広島市)"   , 34.397f , 132.460f },
+    { "山口県(山口市)"   , 34.186f , 131.471f },
+    { "徳島県(徳島市)"   , 34.066f , 134.559f },
+    { "香川県(高松市)"   , 34.340f , 134.043f },
+    { "愛媛県(松山市)"   , 33.842f , 132.766f },
+    { "高知県(高知市)"   , 33.560f , 133.531f },
+    { "福岡県(福岡市)"   , 33.607f , 130.418f },
+    { "佐賀県(佐賀市)"   , 33.249f , 130.299f },
+    { "長崎県(長崎市)"   , 32.745f , 129.874f },
+    { "熊本県(熊本市)"   , 32.790f , 130.742f },
+    { "大分県(大分市)"   , 33.238f , 131.613f },
+    { "宮崎県(宮崎市)"   , 31.911f , 131.424f },
+    { "鹿児島県(鹿児島市)", 31.560f , 130.558f },
+    { "沖縄県(那覇市)"   , 26.212f , 127.681f },
+};
+inline constexpr int HOME_LOCATION_COUNT = sizeof(HOME_LOCATION_CONFIG) / sizeof(HOME_LOCATION_CONFIG[0]);
@@ -0,0 +1,15 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include "config_internal.hpp"
+
+struct MonitorConfig {
+    int stackWarning; // bytes of free stack
+    int heapWarning;  // bytes of minimum free heap
+};
+inline constexpr MonitorConfig MONITOR_CONFIG = {
+    .stackWarning = 512,
+    .heapWarning = 16 * 1024,
+};
@@ -23,91 +23,157 @@ inline const char *displayString(RealtimeImgType value) {
     }
 }
 
+// Recovery when an update takes longer than the update interval and seconds are skipped.
+DEF_CONFIG_ENUM(OverrunMode, SkipToLatest, Backfill, ReduceWork);
+inline const char *displayString(OverrunMode value) {
+    switch (value.value) {
+    case OverrunMode::SkipToLatest: return "最新へ";
+    case OverrunMode::Backfill    : return "後で取得";
+    case OverrunMode::ReduceWork  : return "処理軽減";
+    default                       : return "Unknown";
+    }
+}
+inline const char *identifier(OverrunMode value) {
+    switch (value.value) {
+    case OverrunMode::SkipToLatest: return "skip";
+    case OverrunMode::Backfill    : return "backfill";
+    case OverrunMode::ReduceWork  : return "reduce";
+    default                       : return "unknown";
+    }
+}
+
+DEF_CONFIG_ENUM(HTTPEndpoint, Forecast, Realtime, PsWave, BaseMap);
+inline const char *identifier(HTTPEndpoint value) {
+    switch (value.value) {
+    case HTTPEndpoint::Forecast: return "forecast";
+    case HTTPEndpoint::Realtime: return "realtime";
+    case HTTPEndpoint::PsWave  : return "pswave";
+    case HTTPEndpoint::BaseMap : return "basemap";
+    default                    : return "unknown";
+    }
+}
+
+// Equirectangular approximation of the server map images, longitude/latitude of the image edges.
+struct MapProjectionConfig {
+    float west;
+    float east;
+    float north;
+    float south;
+};
+
 struct MapRegionConfig {
     const char *identifier;
-    const char *baseMapUrl;
-    const char *surfaceUrlFormats[RealtimeImgType::count];
-    const char *boreholeUrlFormats[RealtimeImgType::count];
-    const char *psWaveUrlFormat;
+    MapProjectionConfig projection;
+    const char *baseMapPath;
+    const char *surfacePathFormats[RealtimeImgType::count];
+    const char *boreholePathFormats[RealtimeImgType::count];
+    const char *psWavePathFormat;
+};
+
+inline constexpr int SERVER_MIRROR_MAX = 4;
+struct ServerMirrorConfig {
+    const char *baseUrl;
+    const char *address; // optional static IPv4 address of the host, skips name resolution
 };
 
 struct ServerConfig {
     int imgWidth;
     int imgHeight;
     int timeOffset;
+    int minTimeOffset;
+    int maxTimeOffset;
+    int timeOffsetStep;
     int updateInterval;
-    int idleUpdateInterval;
+    int statsInterval;
+    ServerMirrorConfig mirrors[SERVER_MIRROR_MAX]; // ordered by preference
+    int hedgePercentile;
+    int hedgeMinDelay;
     MapRegionConfig regions[MapRegion::count];
-    const char *forecastUrlFormat;
+    const char *forecastPathFormat;
+
+    constexpr int mirrorCount() const {
+        int count = 0;
+        while (count < SERVER_MIRROR_MAX && mirrors[count].baseUrl) count++;
+        return count;
+    }
 };
 
-#define SERVER "http://www.kmoni.bosai.go.jp"
-// #define SERVER "http://192.168.1.86:8000"
 inline constexpr ServerConfig SERVER_CONFIG = {
     .imgWidth = 352,
     .imgHeight = 400,
-    .timeOffset = -2000, // msec
+    .timeOffset = -2000, // msec, initial value
+    .minTimeOffset = -5000, // msec
+    .maxTimeOffset = -500, // msec
+    .timeOffsetStep = 100, // msec
     .updateInterval = 1, // sec
-    .idleUpdateInterval = 10, // sec
+    .statsInterval = 300, // sec
+    .mirrors = {
+        { .baseUrl = "http://www.kmoni.bosai.go.jp", .address = nullptr },
+        // { .baseUrl = "http://kmoni-mirror.local:8000", .address = "192.168.1.86" },
+    },
+    .hedgePercentile = 90, // hedge to the next mirror once the primary is slower than this percentile
+    .hedgeMinDelay = 100, // msec
     .regions = {
         {
             .identifier = "japan",
-            .baseMapUrl = SERVER "/data/map_img/CommonImg/base_map_w.gif",
-            .surfaceUrlFormats = {
-                SERVER "/data/map_img/RealTimeImg/jma_s/%Y%m%d/%Y%m%d%H%M%S.jma_s.gif",
-                SERVER "/data/map_img/RealTimeImg/acmap_s/%Y%m%d/%Y%m%d%H%M%S.acmap_s.gif",
-                SERVER "/data/map_img/RealTimeImg/vcmap_s/%Y%m%d/%Y%m%d%H%M%S.vcmap_s.gif",
-                SERVER "/data/map_img/RealTimeImg/dcmap_s/%Y%m%d/%Y%m%d%H%M%S.dcmap_s.gif",
-                SERVER "/data/map_img/RealTimeImg/rsp0125_s/%Y%m%d/%Y%m%d%H%M%S.rsp0125_s.gif",
-                SERVER "/data/map_img/RealTimeImg/rsp0250_s/%Y%m%d/%Y%m%d%H%M%S.rsp0250_s.gif",
-                SERVER "/data/map_img/RealTimeImg/rsp0500_s/%Y%m%d/%Y%m%d%H%M%S.rsp0500_s.gif",
-                SERVER "/data/map_img/RealTimeImg/rsp1000_s/%Y%m%d/%Y%m%d%H%M%S.rsp1000_s.gif",
-                SERVER "/data/map_img/RealTimeImg/rsp2000_s/%Y%m%d/%Y%m%d%H%M%S.rsp2000_s.gif",
-                SERVER "/data/map_img/RealTimeImg/rsp4000_s/%Y%m%d/%Y%m%d%H%M%S.rsp4000_s.gif",
+            .projection = { .west = 128.8f, .east = 146.2f, .north = 46.3f, .south = 30.0f }, // approximate fit
+            .baseMapPath = "/data/map_img/CommonImg/base_map_w.gif",
+            .surfacePathFormats = {
+                "/data/map_img/RealTimeImg/jma_s/%Y%m%d/%Y%m%d%H%M%S.jma_s.gif",
+                "/data/map_img/RealTimeImg/acmap_s/%Y%m%d/%Y%m%d%H%M%S.acmap_s.gif",
+                "/data/map_img/RealTimeImg/vcmap_s/%Y%m%d/%Y%m%d%H%M%S.vcmap_s.gif",
+                "/data/map_img/RealTimeImg/dcmap_s/%Y%m%d/%Y%m%d%H%M%S.dcmap_s.gif",
+                "/data/map_img/RealTimeImg/rsp0125_s/%Y%m%d/%Y%m%d%H%M%S.rsp0125_s.gif",
+                "/data/map_img/RealTimeImg/rsp0250_s/%Y%m%d/%Y%m%d%H%M%S.rsp0250_s.gif",
+                "/data/map_img/RealTimeImg/rsp0500_s/%Y%m%d/%Y%m%d%H%M%S.rsp0500_s.gif",
+                "/data/map_img/RealTimeImg/rsp1000_s/%Y%m%d/%Y%m%d%H%M%S.rsp1000_s.gif",
+                "/data/map_img/RealTimeImg/rsp2000_s/%Y%m%d/%Y%m%d%H%M%S.rsp2000_s.gif",
+                "/data/map_img/RealTimeImg/rsp4000_s/%Y%m%d/%Y%m%d%H%M%S.rsp4000_s.gif",
             },
-            .boreholeUrlFormats = {
-                SERVER "/data/map_img/RealTimeImg/jma_b/%Y%m%d/%Y%m%d%H%M%S.jma_b.gif",
-                SERVER "/data/map_img/RealTimeImg/acmap_b/%Y%m%d/%Y%m%d%H%M%S.acmap_b.gif",
-                SERVER "/data/map_img/RealTimeImg/vcmap_b/%Y%m%d/%Y%m%d%H%M%S.vcmap_b.gif",
-                SERVER "/data/map_img/RealTimeImg/dcmap_b/%Y%m%d/%Y%m%d%H%M%S.dcmap_b.gif",
-                SERVER "/data/map_img/RealTimeImg/rsp0125_b/%Y%m%d/%Y%m%d%H%M%S.rsp0125_b.gif",
-                SERVER "/data/map_img/RealTimeImg/rsp0250_b/%Y%m%d/%Y%m%d%H%M%S.rsp0250_b.gif",
-                SERVER "/data/map_img/RealTimeImg/rsp0500_b/%Y%m%d/%Y%m%d%H%M%S.rsp0500_b.gif",
-                SERVER "/data/map_img/RealTimeImg/rsp1000_b/%Y%m%d/%Y%m%d%H%M%S.rsp1000_b.gif",
-                SERVER "/data/map_img/RealTimeImg/rsp2000_b/%Y%m%d/%Y%m%d%H%M%S.rsp2000_b.gif",
-                SERVER "/data/map_img/RealTimeImg/rsp4000_b/%Y%m%d/%Y%m%d%H%M%S.rsp4000_b.gif",
+            .boreholePathFormats = {
+                "/data/map_img/RealTimeImg/jma_b/%Y%m%d/%Y%m%d%H%M%S.jma_b.gif",
+                "/data/map_img/RealTimeImg/acmap_b/%Y%m%d/%Y%m%d%H%M%S.acmap_b.gif",
+                "/data/map_img/RealTimeImg/vcmap_b/%Y%m%d/%Y%m%d%H%M%S.vcmap_b.gif",
+                "/data/map_img/RealTimeImg/dcmap_b/%Y%m%d/%Y%m%d%H%M%S.dcmap_b.gif",
+                "/data/map_img/RealTimeImg/rsp0125_b/%Y%m%d/%Y%m%d%H%M%S.rsp0125_b.gif",
+                "/data/map_img/RealTimeImg/rsp0250_b/%Y%m%d/%Y%m%d%H%M%S.rsp0250_b.gif",
+                "/data/map_img/RealTimeImg/rsp0500_b/%Y%m%d/%Y%m%d%H%M%S.rsp0500_b.gif",
+                "/data/map_img/RealTimeImg/rsp1000_b/%Y%m%d/%Y%m%d%H%M%S.rsp1000_b.gif",
+                "/data/map_img/RealTimeImg/rsp2000_b/%Y%m%d/%Y%m%d%H%M%S.rsp2000_b.gif",
+                "/data/map_img/RealTimeImg/rsp4000_b/%Y%m%d/%Y%m%d%H%M%S.rsp4000_b.gif",
             },
-            .psWaveUrlFormat = SERVER "/data/map_img/PSWaveImg/eew/%Y%m%d/%Y%m%d%H%M%S.eew.gif",
+            .psWavePathFormat = "/data/map_img/PSWaveImg/eew/%Y%m%d/%Y%m%d%H%M%S.eew.gif",
         },
         {
             .identifier = "noto",
-            .baseMapUrl = SERVER "/data/map_img/CommonImg_noto/base_map_w.gif",
-            .surfaceUrlFormats = {
-                SERVER "/data/map_img/RealTimeImg_noto/jma_s/%Y%m%d/%Y%m%d%H%M%S.jma_s.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/acmap_s/%Y%m%d/%Y%m%d%H%M%S.acmap_s.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/vcmap_s/%Y%m%d/%Y%m%d%H%M%S.vcmap_s.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/dcmap_s/%Y%m%d/%Y%m%d%H%M%S.dcmap_s.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/rsp0125_s/%Y%m%d/%Y%m%d%H%M%S.rsp0125_s.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/rsp0250_s/%Y%m%d/%Y%m%d%H%M%S.rsp0250_s.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/rsp0500_s/%Y%m%d/%Y%m%d%H%M%S.rsp0500_s.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/rsp1000_s/%Y%m%d/%Y%m%d%H%M%S.rsp1000_s.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/rsp2000_s/%Y%m%d/%Y%m%d%H%M%S.rsp2000_s.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/rsp4000_s/%Y%m%d/%Y%m%d%H%M%S.rsp4000_s.gif",
+            .projection = { .west = 135.9f, .east = 138.1f, .north = 38.0f, .south = 36.0f }, // approximate fit
+            .baseMapPath = "/data/map_img/CommonImg_noto/base_map_w.gif",
+            .surfacePathFormats = {
+                "/data/map_img/RealTimeImg_noto/jma_s/%Y%m%d/%Y%m%d%H%M%S.jma_s.gif",
+                "/data/map_img/RealTimeImg_noto/acmap_s/%Y%m%d/%Y%m%d%H%M%S.acmap_s.gif",
+                "/data/map_img/RealTimeImg_noto/vcmap_s/%Y%m%d/%Y%m%d%H%M%S.vcmap_s.gif",
+                "/data/map_img/RealTimeImg_noto/dcmap_s/%Y%m%d/%Y%m%d%H%M%S.dcmap_s.gif",
+                "/data/map_img/RealTimeImg_noto/rsp0125_s/%Y%m%d/%Y%m%d%H%M%S.rsp0125_s.gif",
+                "/data/map_img/RealTimeImg_noto/rsp0250_s/%Y%m%d/%Y%m%d%H%M%S.rsp0250_s.gif",
+                "/data/map_img/RealTimeImg_noto/rsp0500_s/%Y%m%d/%Y%m%d%H%M%S.rsp0500_s.gif",
+                "/data/map_img/RealTimeImg_noto/rsp1000_s/%Y%m%d/%Y%m%d%H%M%S.rsp1000_s.gif",
+                "/data/map_img/RealTimeImg_noto/rsp2000_s/%Y%m%d/%Y%m%d%H%M%S.rsp2000_s.gif",
+                "/data/map_img/RealTimeImg_noto/rsp4000_s/%Y%m%d/%Y%m%d%H%M%S.rsp4000_s.gif",
             },
-            .boreholeUrlFormats = {
-                SERVER "/data/map_img/RealTimeImg_noto/jma_b/%Y%m%d/%Y%m%d%H%M%S.jma_b.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/acmap_b/%Y%m%d/%Y%m%d%H%M%S.acmap_b.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/vcmap_b/%Y%m%d/%Y%m%d%H%M%S.vcmap_b.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/dcmap_b/%Y%m%d/%Y%m%d%H%M%S.dcmap_b.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/rsp0125_b/%Y%m%d/%Y%m%d%H%M%S.rsp0125_b.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/rsp0250_b/%Y%m%d/%Y%m%d%H%M%S.rsp0250_b.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/rsp0500_b/%Y%m%d/%Y%m%d%H%M%S.rsp0500_b.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/rsp1000_b/%Y%m%d/%Y%m%d%H%M%S.rsp1000_b.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/rsp2000_b/%Y%m%d/%Y%m%d%H%M%S.rsp2000_b.gif",
-                SERVER "/data/map_img/RealTimeImg_noto/rsp4000_b/%Y%m%d/%Y%m%d%H%M%S.rsp4000_b.gif",
+            .boreholePathFormats = {
+                "/data/map_img/RealTimeImg_noto/jma_b/%Y%m%d/%Y%m%d%H%M%S.jma_b.gif",
+                "/data/map_img/RealTimeImg_noto/acmap_b/%Y%m%d/%Y%m%d%H%M%S.acmap_b.gif",
+                "/data/map_img/RealTimeImg_noto/vcmap_b/%Y%m%d/%Y%m%d%H%M%S.vcmap_b.gif",
+                "/data/map_img/RealTimeImg_noto/dcmap_b/%Y%m%d/%Y%m%d%H%M%S.dcmap_b.gif",
+                "/data/map_img/RealTimeImg_noto/rsp0125_b/%Y%m%d/%Y%m%d%H%M%S.rsp0125_b.gif",
+                "/data/map_img/RealTimeImg_noto/rsp0250_b/%Y%m%d/%Y%m%d%H%M%S.rsp0250_b.gif",
+                "/data/map_img/RealTimeImg_noto/rsp0500_b/%Y%m%d/%Y%m%d%H%M%S.rsp0500_b.gif",
+                "/data/map_img/RealTimeImg_noto/rsp1000_b/%Y%m%d/%Y%m%d%H%M%S.rsp1000_b.gif",
+                "/data/map_img/RealTimeImg_noto/rsp2000_b/%Y%m%d/%Y%m%d%H%M%S.rsp2000_b.gif",
+                "/data/map_img/RealTimeImg_noto/rsp4000_b/%Y%m%d/%Y%m%d%H%M%S.rsp4000_b.gif",
             },
-            .psWaveUrlFormat = SERVER "/data/map_img/PSWaveImg_noto/eew/%Y%m%d/%Y%m%d%H%M%S.eew.gif",
+            .psWavePathFormat = "/data/map_img/PSWaveImg_noto/eew/%Y%m%d/%Y%m%d%H%M%S.eew.gif",
         },
     },
-    .forecastUrlFormat = SERVER "/webservice/hypo/eew/%Y%m%d%H%M%S.json",
+    .forecastPathFormat = "/webservice/hypo/eew/%Y%m%d%H%M%S.json",
 };
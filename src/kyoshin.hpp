@@ -9,8 +9,10 @@
 #include "ui.hpp"
 #include "config/server_config.hpp"
 #include "modules/flash_img_controller.hpp"
+#include "modules/mirror_client.hpp"
 #include "modules/settings.hpp"
 #include "modules/sound_controller.hpp"
+#include "modules/time_offset_controller.hpp"
 
 using std::function;
 using std::string;
@@ -27,10 +29,14 @@ union ImageBuffer {
 };
 extern ImageBuffer imgBuffer;
 extern Networking::HTTPClient httpClient;
+extern Networking::HTTPStats baseMapStats;
+extern MirrorClient mirrorClient;
 extern RTOS::Task<portMAX_DELAY> bgTask1;
+extern RTOS::Task<portMAX_DELAY> renderTask;
 extern Settings settings;
 extern FlashImageController flashImage;
 extern SoundController soundController;
+extern TimeOffsetController timeOffsetController;
 
 // Common
 #define defaultFount lgfxJapanGothicP_24
@@ -1,26 +1,36 @@
 #include <M5Unified.h>
 #include "nvs.hpp"
+#include "system_monitor.hpp"
 #include "networking.hpp"
 #include "ui.hpp"
 #include "kyoshin.hpp"
+#include "config/monitor_config.hpp"
 #include "scenes/wifi_connect_scene.hpp"
 #include "scenes/wifi_setup_scene.hpp"
 
 // Shared Instances
 ImageBuffer imgBuffer;
 Networking::HTTPClient httpClient(20 * 1024); // 18KB Buffer
+Networking::HTTPStats baseMapStats; // the realtime endpoints are counted per mirror
+MirrorClient mirrorClient;
 RTOS::Task<portMAX_DELAY> bgTask1("bgTask1");
+RTOS::Task<portMAX_DELAY> renderTask("render");
 Settings settings;
 FlashImageController flashImage;
 SoundController soundController;
+TimeOffsetController timeOffsetController;
 
 extern "C" void app_main() {
     NVS::init();
+    SystemMonitor::setWarningThresholds(MONITOR_CONFIG.stackWarning, MONITOR_CONFIG.heapWarning);
     Networking::init();
 
     bgTask1.createQueue();
     bgTask1.start(RTOS::TaskPriority::Normal, 1024 * 3, 1);
+    renderTask.createQueue(4);
+    renderTask.start(RTOS::TaskPriority::Normal, 1024 * 3, 1);
     httpClient.clearBuffer();
+    mirrorClient.start(httpClient, httpClient.bufferSize);
     settings.restore();
     flashImage.init();
 
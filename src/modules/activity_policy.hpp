@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <cstdio>
+#include "date.hpp"
+#include "types.hpp"
+#include "ui.hpp"
+#include "config/activity_config.hpp"
+
+// Steps the update rate down while nothing happens: after sustained quiet with the display dimmed
+// the realtime image is fetched less often and the UI task cycles slower. A forecast or shaking
+// above the intensity threshold returns to the active state in the same cycle.
+// Called from the fetch stage only.
+class ActivityPolicy : private NoMove {
+    ActivityState state = ActivityState::Active;
+    Date lastActivity;
+    Date stateStart;
+    Date statsStart;
+    uint32_t stateTime[ActivityState::count] = {}; // msec since the last report
+    uint32_t seconds[ActivityState::count] = {};
+    uint32_t fetches[ActivityState::count] = {};
+
+    void enter(ActivityState next, Date now) {
+        stateTime[state.value] += now - stateStart;
+        stateStart = now;
+        printf("activity: %s -> %s\n", identifier(state), identifier(next));
+        auto &config = ACTIVITY_STATE_CONFIG[next.value];
+        UI::setFrameInterval(config.frameInterval);
+        state = next;
+    }
+
+public:
+    // Feeds the observations of an update second: whether a forecast is shown, whether the display
+    // is on, and the number of pixels at or above the active intensity level in the last image.
+    ActivityState observe(Date now, bool forecast, bool displayIsOn, int intensePixels) {
+        if (forecast || displayIsOn || intensePixels >= ACTIVE_INTENSITY_PIXELS) lastActivity = now;
+        int quiet = (now - lastActivity) / 1000;
+        ActivityState next = ActivityState::Active;
+        for (int i = ActivityState::count - 1; i > 0; i--) {
+            if (quiet < ACTIVITY_STATE_CONFIG[i].quietAfter) continue;
+            next = ActivityState(i);
+            break;
+        }
+        if (next != state) enter(next, now);
+        seconds[state.value]++;
+        return state;
+    }
+    ActivityState current() const {
+        return state;
+    }
+    // Whether the realtime image of the target second is fetched in the current state.
+    bool shouldFetch(time_t target) const {
+        return target % ACTIVITY_STATE_CONFIG[state.value].updateInterval == 0;
+    }
+    void recordFetch() {
+        fetches[state.value]++;
+    }
+
+    // Prints the time spent in each state and the share of seconds with an image fetch since the
+    // last report.
+    void print() {
+        Date now;
+        stateTime[state.value] += now - stateStart;
+        stateStart = now;
+        uint32_t period = now - statsStart, totalSeconds = 0, totalFetches = 0;
+        if (period == 0) return;
+        for (int i = 0; i < ActivityState::count; i++) {
+            totalSeconds += seconds[i];
+            totalFetches += fetches[i];
+        }
+        printf("activity (%s): duty cycle %u%%\n", identifier(state), (unsigned)(totalSeconds ? totalFetches * 100 / totalSeconds : 0));
+        for (int i = 0; i < ActivityState::count; i++) {
+            printf("  %-8s time %3u%%, %us, fetches %u/%u\n", identifier(ActivityState(i)), (unsigned)(stateTime[i] * 100 / period),
+                (unsigned)(stateTime[i] / 1000), (unsigned)fetches[i], (unsigned)seconds[i]);
+            stateTime[i] = seconds[i] = fetches[i] = 0;
+        }
+        statsStart = now;
+    }
+};
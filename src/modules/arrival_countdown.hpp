@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include "date.hpp"
+#include "fixed_string.hpp"
+#include "config/location_config.hpp"
+#include "modules/forecast.hpp"
+#include "modules/travel_time.hpp"
+
+// Seconds until the S-wave of the shown event reaches the home location. The arrival time is
+// computed once per report, so the per-tick work is a subtraction.
+class ArrivalCountdown {
+    FixedString<24> reportId;
+    FixedString<24> reportTime;
+    int location = -1;
+    Date arrival = 0;
+    int shown = 0;
+    bool valid = false;
+
+public:
+    // Recomputes the countdown, returns true if the displayed value changed.
+    bool update(const ForecastReport &report, int homeLocation, Date now) {
+        if (report.reportId != reportId || report.reportTime != reportTime || homeLocation != location) {
+            reportId = report.reportId;
+            reportTime = report.reportTime;
+            location = homeLocation;
+            bool wasValid = valid;
+            valid = homeLocation > 0 && report.located && !report.isCancel;
+            if (valid) {
+                auto &home = HOME_LOCATION_CONFIG[homeLocation];
+                float distance = TravelTime::distance(report.latitude, report.longitude, home.latitude, home.longitude);
+                arrival = report.originTime + (long long)(TravelTime::arrivalTime(TravelTime::Phase::S, report.depthKm, distance) * 1000);
+            }
+            if (valid != wasValid) {
+                shown = seconds(now);
+                return true;
+            }
+        }
+        if (!valid) return false;
+        int value = seconds(now);
+        if (value == shown) return false;
+        shown = value;
+        return true;
+    }
+
+    bool isValid() const {
+        return valid;
+    }
+    // Remaining whole seconds, 0 once the wave has arrived.
+    int seconds(Date now) const {
+        long long remaining = arrival - now;
+        return remaining > 0 ? (int)((remaining + 999) / 1000) : 0;
+    }
+};
@@ -3,53 +3,236 @@
  */
 
 #pragma once
+#include <cstdio>
+#include <cstdlib>
 #include <string>
+#include <string_view>
 #include "M5Unified.h"
-#include "json_parser.hpp"
-
-struct Forecast {
-    std::string reportId;
-    std::string reportTime;
-    std::string reportNum;
-    std::string alertflg;
-    std::string calcintensity;
-    std::string magnitude;
-    std::string depth;
-    std::string regionName;
-    bool isCancel;
-    bool isFinal;
-    bool isTraining;
-
-    std::string prevReportTime = "";
+#include "date.hpp"
+#include "fixed_string.hpp"
+#include "json_scanner.hpp"
+
+struct ForecastReport {
+    FixedString<24> reportId;
+    FixedString<24> reportTime;
+    FixedString<8> reportNum;
+    FixedString<16> alertflg;
+    FixedString<8> calcintensity;
+    FixedString<8> magnitude;
+    FixedString<16> depth;
+    FixedString<64> regionName;
+    bool isCancel = false;
+    bool isFinal = false;
+    bool isTraining = false;
+    // hypocenter, valid if located
+    bool located = false;
+    float latitude = 0;
+    float longitude = 0;
+    float depthKm = 0;
+    Date originTime = 0;
+
+    static float number(const JSONScanner::Value &value) {
+        FixedString<16> text;
+        if (value.isString()) value.stringValue(text);
+        else text.assign(value.raw.data(), value.raw.size());
+        return atof(text.c_str());
+    }
+    static Date time(const JSONScanner::Value &value) {
+        FixedString<16> text;
+        value.stringValue(text);
+        int year, month, day, hour, minute, second;
+        if (sscanf(text.c_str(), "%4d%2d%2d%2d%2d%2d", &year, &month, &day, &hour, &minute, &second) != 6) return 0;
+        return Date(year, month, day, hour, minute, second);
+    }
+
+    // Extracts the known members from an EEW json body, returns true if the result status is success.
+    bool parse(const char *json, size_t length) {
+        bool success = false, hasLatitude = false, hasLongitude = false;
+        JSONScanner::scan(json, length, [&](std::string_view path, std::string_view key, const JSONScanner::Value &value) {
+            if (path == "result") {
+                if (key == "status") success = value.isString() && value.raw == "success";
+                return;
+            }
+            if (!path.empty()) return;
+            if (key == "report_id") value.stringValue(reportId);
+            else if (key == "report_time") value.stringValue(reportTime);
+            else if (key == "report_num") value.stringValue(reportNum);
+            else if (key == "alertflg") value.stringValue(alertflg);
+            else if (key == "calcintensity") value.stringValue(calcintensity);
+            else if (key == "magunitude") value.stringValue(magnitude);
+            else if (key == "depth") {
+                value.stringValue(depth);
+                depthKm = atoi(depth.c_str()); // "10km"
+            }
+            else if (key == "latitude") { latitude = number(value); hasLatitude = !value.raw.empty(); }
+            else if (key == "longitude") { longitude = number(value); hasLongitude = !value.raw.empty(); }
+            else if (key == "origin_time") originTime = time(value);
+            else if (key == "region_name") value.stringValue(regionName);
+            else if (key == "is_cancel") isCancel = value.boolValue();
+            else if (key == "is_final") isFinal = value.boolValue();
+            else if (key == "is_training") isTraining = value.boolValue();
+        });
+        located = hasLatitude && hasLongitude && (bool)originTime;
+        return success;
+    }
+
+    // Seismic intensity as an ordered rank, -1 if unknown.
+    int intensityRank() const {
+        static constexpr const char *ranks[] = { "0", "1", "2", "3", "4", "5弱", "5強", "6弱", "6強", "7" };
+        for (int i = 0; i < (int)(sizeof(ranks) / sizeof(ranks[0])); i++) {
+            if (calcintensity == ranks[i]) return i;
+        }
+        return -1;
+    }
+    int reportNumber() const {
+        return atoi(reportNum.c_str());
+    }
+    // Deterministic order used to pick the event shown and sounded when several are active.
+    bool isPreferredTo(const ForecastReport &other) const {
+        if (isCancel != other.isCancel) return !isCancel;
+        if (isTraining != other.isTraining) return !isTraining;
+        bool alert = alertflg == "警報", otherAlert = other.alertflg == "警報";
+        if (alert != otherAlert) return alert;
+        if (intensityRank() != other.intensityRank()) return intensityRank() > other.intensityRank();
+        if (reportTime != other.reportTime) return std::string_view(reportTime) > std::string_view(other.reportTime);
+        return std::string_view(reportId) > std::string_view(other.reportId);
+    }
+};
+
+// The server returns the latest report of any active event, so overlapping earthquakes show up
+// alternately. Events are kept apart by report id, and the ForecastReport part always holds the
+// primary event.
+struct Forecast : ForecastReport {
+    static constexpr int capacity = 4;
+    static constexpr int expireTime = 180 * 1000; // drop an event not reported for this long
+
+    struct Event {
+        ForecastReport report;
+        Date lastSeen = 0;
+        int reports = 0; // distinct reports received
+    };
+
+private:
+    Event events[capacity];
+    int count = 0;
+
+    Event *find(std::string_view id) {
+        for (int i = 0; i < count; i++) {
+            if (events[i].report.reportId == id) return &events[i];
+        }
+        return nullptr;
+    }
+    Event *insert() {
+        if (count < capacity) return &events[count++];
+        Event *oldest = &events[0];
+        for (int i = 1; i < count; i++) {
+            if (events[i].lastSeen < oldest->lastSeen) oldest = &events[i];
+        }
+        printf("forecast: event table full, dropping %s\n", oldest->report.reportId.c_str());
+        *oldest = Event();
+        return oldest;
+    }
+    void expire(Date now) {
+        for (int i = 0; i < count;) {
+            if (now - events[i].lastSeen < expireTime) { i++; continue; }
+            printf("forecast: event %s expired\n", events[i].report.reportId.c_str());
+            events[i] = events[--count];
+            events[count] = Event();
+        }
+    }
+    void selectPrimary() {
+        const Event *primary = nullptr;
+        for (int i = 0; i < count; i++) {
+            if (!primary || events[i].report.isPreferredTo(primary->report)) primary = &events[i];
+        }
+        static_cast<ForecastReport &>(*this) = primary ? primary->report : ForecastReport();
+    }
+
+public:
+    FixedString<24> prevReportTime;
+    FixedString<24> prevReportId;
 
     void clear() {
-        reportId.clear();
-        reportTime.clear();
-        alertflg.clear();
-        calcintensity.clear();
-        magnitude.clear();
-        depth.clear();
-        regionName.clear();
-        isCancel = false;
-        isFinal = false;
-        isTraining = false;
+        for (auto &event : events) event = Event();
+        count = 0;
+        static_cast<ForecastReport &>(*this) = ForecastReport();
         prevReportTime.clear();
+        prevReportId.clear();
+    }
+
+    // Copies the events and the primary report, keeping the report seen by isStarted() and isUpdated().
+    void assign(const Forecast &other) {
+        auto seenTime = prevReportTime;
+        auto seenId = prevReportId;
+        *this = other;
+        prevReportTime = seenTime;
+        prevReportId = seenId;
     }
 
-    void update(const char *jsonString) {
-        auto json = JSONValue(jsonString);
-        if (json["result"]["status"].stringValue() != "success") return;
-        reportId = json["report_id"].stringValue();
-        reportTime = json["report_time"].stringValue();
-        reportNum = json["report_num"].stringValue();
-        alertflg = json["alertflg"].stringValue();
-        calcintensity = json["calcintensity"].stringValue();
-        magnitude = json["magunitude"].stringValue();
-        depth = json["depth"].stringValue();
-        regionName = json["region_name"].stringValue();
-        isCancel = json["is_cancel"].boolValue();
-        isFinal = json["is_final"].boolValue();
-        isTraining = json["is_training"].boolValue();
+    int eventCount() const {
+        return count;
+    }
+    const Event &event(int index) const {
+        return events[index];
+    }
+    // True if every active event has a hypocenter, so the wave fronts can be computed locally.
+    bool isLocated() const {
+        if (count == 0) return false;
+        for (int i = 0; i < count; i++) {
+            if (!events[i].report.located && !events[i].report.isCancel) return false;
+        }
+        return true;
+    }
+
+    // Raw value of a top level string member, found by a plain text search.
+    static std::string_view peekString(std::string_view json, std::string_view key) {
+        for (size_t pos = json.find(key); pos != std::string_view::npos; pos = json.find(key, pos + 1)) {
+            if (pos == 0 || json[pos - 1] != '"' || pos + key.size() >= json.size() || json[pos + key.size()] != '"') continue;
+            size_t begin = json.find_first_not_of(" \t\r\n", pos + key.size() + 1);
+            if (begin == std::string_view::npos || json[begin] != ':') return {};
+            begin = json.find_first_not_of(" \t\r\n", begin + 1);
+            if (begin == std::string_view::npos || json[begin] != '"') return {};
+            size_t end = json.find('"', ++begin);
+            if (end == std::string_view::npos) return {};
+            return json.substr(begin, end - begin);
+        }
+        return {};
+    }
+
+    // A backfilled body is from a past second, so a "no event" body does not clear the table.
+    void update(const char *jsonString, size_t length, Date now, bool backfilled = false) {
+        // Most polls return a report already in the table (or the same "no event" body), so compare
+        // the report id and number before parsing the whole body.
+        std::string_view json(jsonString, length);
+        auto id = peekString(json, "report_id"), num = peekString(json, "report_num");
+        auto event = id.empty() ? nullptr : find(id);
+        if (event && event->report.reportNum == num) {
+            event->lastSeen = now;
+            expire(now);
+            selectPrimary();
+            return;
+        }
+        if (id.empty() && count == 0) return;
+
+        ForecastReport report;
+        if (!report.parse(jsonString, length)) return;
+        if (report.reportId.empty()) {
+            if (backfilled) return;
+            // the server reports no active event
+            for (int i = 0; i < count; i++) events[i] = Event();
+            count = 0;
+            selectPrimary();
+            return;
+        }
+        if (!event) event = insert();
+        event->lastSeen = now;
+        // reports of one event may arrive out of order from different mirrors
+        if (event->reports == 0 || report.reportNumber() >= event->report.reportNumber()) {
+            event->report = report;
+            event->reports++;
+        }
+        expire(now);
+        selectPrimary();
     }
 
     bool empty() const {
@@ -72,18 +255,20 @@ struct Forecast {
         if (isCancel) return "キャンセル報";
         if (isTraining) return "訓練報";
         if (isFinal) return "最終報";
-        return "第" + reportNum + "報";
+        return std::string("第") + reportNum.c_str() + "報";
     }
 
+    // Both follow the primary event, so a report of a secondary event does not count as an update.
     bool isStarted() {
-        if (reportTime == prevReportTime) return false;
+        if (reportId == prevReportId && reportTime == prevReportTime) return false;
         return prevReportTime.empty();
     }
     bool isUpdated() {
-        if (reportTime == prevReportTime) return false;
+        if (reportId == prevReportId && reportTime == prevReportTime) return false;
         return !reportTime.empty();
     }
     void updateReportTime() {
+        prevReportId = reportId;
         prevReportTime = reportTime;
     }
 };
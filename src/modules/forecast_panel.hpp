@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <cstdio>
+#include <string>
+#include "M5Unified.h"
+#include "esp_timer.h"
+#include "fixed_string.hpp"
+#include "types.hpp"
+#include "ui.hpp"
+#include "modules/forecast.hpp"
+#include "resources/fonts.hpp"
+
+// Forecast panel on the right of the map. It is rendered into a persistent sprite only when one of
+// the shown fields changes, otherwise the cached sprite is pushed again if the panel was drawn over.
+class ForecastPanel : private NoMove {
+    struct Fields {
+        bool empty = true;
+        uint32_t color = 0;
+        FixedString<16> alertflg;
+        FixedString<8> calcintensity;
+        FixedString<8> magnitude;
+        FixedString<16> depth;
+        FixedString<64> regionName;
+        FixedString<24> reportNum;
+
+        bool operator==(const Fields &other) const {
+            return empty == other.empty && color == other.color && std::string_view(alertflg) == std::string_view(other.alertflg) &&
+                std::string_view(calcintensity) == std::string_view(other.calcintensity) && std::string_view(magnitude) == std::string_view(other.magnitude) &&
+                std::string_view(depth) == std::string_view(other.depth) && std::string_view(regionName) == std::string_view(other.regionName) &&
+                std::string_view(reportNum) == std::string_view(other.reportNum);
+        }
+    };
+    struct Stats {
+        uint32_t count = 0;
+        int64_t time = 0; // usec
+        void add(int64_t elapsed) { count++; time += elapsed; }
+        uint32_t average() const { return count ? time / count : 0; }
+    };
+
+    M5Canvas sprite = M5Canvas(&M5.Display);
+    Fields shown;
+    bool rendered = false;
+    int spriteWidth = 0, spriteHeight = 0;
+    Stats renders, pushes;
+    uint32_t skipped = 0;
+
+    static Fields fields(Forecast &forecast) {
+        Fields fields;
+        fields.empty = forecast.empty();
+        if (fields.empty) return fields;
+        fields.color = forecast.color();
+        fields.alertflg = forecast.alertflg;
+        fields.calcintensity = forecast.calcintensity;
+        fields.magnitude = forecast.magnitude;
+        fields.depth = forecast.depth;
+        fields.regionName = forecast.regionName;
+        auto reportNum = forecast.reportNumString();
+        fields.reportNum.assign(reportNum.data(), reportNum.size());
+        return fields;
+    }
+
+    void render(int width, int height) {
+        if (!rendered || width != spriteWidth || height != spriteHeight) {
+            sprite.deleteSprite();
+            sprite.setColorDepth(2);
+            sprite.createSprite(width, height);
+            sprite.createPalette();
+            sprite.setPaletteColor(0, TFT_BLACK);
+            sprite.setPaletteColor(1, TFT_WHITE);
+            spriteWidth = width;
+            spriteHeight = height;
+        }
+        sprite.setPaletteColor(3, TFT_LIGHTGRAY);
+        if (shown.empty) {
+            sprite.fillRect(0, 0, 4, height, 3);
+            sprite.fillRect(4, 0, width - 4, 88, 3);
+            sprite.fillRect(4, 88, width - 4, height - 88, 1);
+            return;
+        }
+        sprite.setPaletteColor(2, shown.color);
+        sprite.fillRect(0, 0, 4, height, 2);
+        int x = 4;
+        width -= 4;
+
+        sprite.fillRect(x, 0, width, 88, 2);
+        UI::drawText(sprite, &lgfxJapanGothicP_24, shown.alertflg.c_str(), x + 4, 8, 1);
+        UI::drawText(sprite, &lgfxJapanGothicP_16, "最大", x + 4, 46, 1);
+        UI::drawText(sprite, &lgfxJapanGothicP_16, "震度", x + 4, 62, 1);
+        UI::drawText(sprite, &lgfxJapanGothicP_40_numbers, shown.calcintensity.c_str(), x + width / 2 + 16, 40, 1, UI::TextAlign::Center);
+
+        sprite.fillRect(x, 88, width, height - 88, 1);
+        UI::drawText(sprite, &lgfxJapanGothicP_24, std::string("M") + shown.magnitude.c_str(), x + width / 2, 96, 0, UI::TextAlign::Center);
+        UI::drawText(sprite, &lgfxJapanGothicP_16, "深さ", x + 4, 126, 0);
+        UI::drawText(sprite, &lgfxJapanGothicP_24, shown.depth.c_str(), x + width - 4, 122, 0, UI::TextAlign::Right);
+        // the S-wave countdown below the depth is drawn separately
+
+        // the region name wraps, it is drawn with the font directly
+        sprite.setTextColor(0, 1);
+        sprite.setCursor(x + 4, 180);
+        sprite.setClipRect(x + 4, 180, width - 8, 60);
+        sprite.setFont(&lgfxJapanGothicP_16);
+        sprite.println(shown.regionName.c_str());
+        sprite.clearClipRect();
+
+        UI::drawText(sprite, &lgfxJapanGothicP_16, shown.reportNum.c_str(), x + width - 4, 218, 0, UI::TextAlign::Right);
+    }
+
+public:
+    ~ForecastPanel() {
+        sprite.deletePalette();
+        sprite.deleteSprite();
+    }
+
+    // Draws the panel at x, returns true if it was pushed to the display.
+    bool draw(Forecast &forecast, int x, int width, int height, bool overdrawn) {
+        int64_t start = esp_timer_get_time();
+        auto current = fields(forecast);
+        bool changed = !rendered || !(current == shown) || width != spriteWidth || height != spriteHeight;
+        if (!changed && !overdrawn) {
+            skipped++;
+            return false;
+        }
+        if (changed) {
+            shown = current;
+            render(width, height);
+            rendered = true;
+        }
+        sprite.pushSprite(x, 0);
+        (changed ? renders : pushes).add(esp_timer_get_time() - start);
+        return true;
+    }
+
+    // Prints the cost of a render against a cached push and how often each happened since the last report.
+    void print() {
+        int64_t renderCost = renders.average(), pushCost = pushes.average();
+        int64_t saved = (renderCost - pushCost) * pushes.count + renderCost * skipped;
+        uint32_t frames = renders.count + pushes.count + skipped;
+        printf("forecast panel: renders %u avg %uus, cached pushes %u avg %uus, skipped %u, saved %uus/frame\n",
+            (unsigned)renders.count, (unsigned)renderCost, (unsigned)pushes.count, (unsigned)pushCost,
+            (unsigned)skipped, (unsigned)(frames && saved > 0 ? saved / frames : 0));
+        renders = pushes = Stats();
+        skipped = 0;
+    }
+};
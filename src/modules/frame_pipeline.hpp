@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include "rtos.hpp"
+#include "date.hpp"
+#include "types.hpp"
+
+// Buffers shared by the update stages. The fetch stage copies the downloaded images into a job,
+// the render stage decodes and resizes them and swaps the result into the front frame, and the
+// display reads the front frame, so each stage can work on a different second.
+// Without memory for a separate front frame, the render stage's work buffer is shown directly and
+// the display skips drawing while a frame is rendered.
+// Published frames are diffed against the front frame, so the display can push only the changed
+// columns of each band of rows. The display may also change the front frame in place between
+// publishes and mark the pixels dirty itself.
+class FramePipeline : private NoMove {
+public:
+    enum Stage { Fetch, Render, Display, StageCount };
+    static constexpr const char *stageNames[StageCount] = { "fetch", "render", "display" };
+    static constexpr int jobCount = 2;
+    static constexpr int maxBands = 16;
+
+    // Changed columns [left, right) of a band.
+    struct Span {
+        uint16_t left = 0;
+        uint16_t right = 0;
+        bool empty() const { return left >= right; }
+    };
+
+    struct Job {
+        uint8_t *body = nullptr;
+        int capacity = 0;
+        int realtimeSize = 0;
+        int psWaveSize = 0;
+        Date target = 0;
+        std::atomic<bool> inUse = false;
+
+        const uint8_t *realtime() const { return body; }
+        const uint8_t *psWave() const { return body + realtimeSize; }
+        // Appends a downloaded body, returns false if it does not fit.
+        bool append(const uint8_t *data, int size, int &field) {
+            int used = realtimeSize + psWaveSize;
+            if (used + size > capacity) return false;
+            memcpy(body + used, data, size);
+            field = size;
+            return true;
+        }
+    };
+
+private:
+    struct StageStats {
+        uint32_t runs = 0;
+        uint32_t busy = 0; // msec since the last report
+        uint32_t max = 0;
+    };
+    Job jobs[jobCount];
+    int jobSlots = 0;
+    uint8_t *front = nullptr;
+    uint8_t *frame = nullptr;
+    uint16_t frameWidth = 0, frameHeight = 0;
+    Date frameTarget = 0;
+    RTOS::Semaphore mutex = RTOS::Semaphore::mutex();
+    // The stats are written by every stage and reset by print(), the lock is held only to copy them.
+    portMUX_TYPE statsLock = portMUX_INITIALIZER_UNLOCKED;
+    StageStats stats[StageCount];
+    std::atomic<uint32_t> dropped = 0;
+    Date statsStart;
+    int bandHeight = 1;
+    Span dirty[maxBands];
+    bool dirtyAll = true;
+    uint32_t displayFrames = 0, fullFrames = 0, pushedPixels = 0, maxPushedPixels = 0;
+    int64_t pushWait = 0; // usec
+
+    // Adds the rows that differ from the front frame to the dirty spans.
+    void diff(const uint8_t *pixels, int width, int height) {
+        if (!frame || frameWidth != width || frameHeight != height || height > maxBands * bandHeight) {
+            dirtyAll = true;
+            return;
+        }
+        for (int y = 0; y < height; y++) {
+            const uint8_t *row = pixels + y * width, *shown = frame + y * width;
+            if (memcmp(row, shown, width) == 0) continue;
+            int left = 0, right = width;
+            while (row[left] == shown[left]) left++;
+            while (row[right - 1] == shown[right - 1]) right--;
+            auto &span = dirty[y / bandHeight];
+            if (span.empty()) {
+                span = { (uint16_t)left, (uint16_t)right };
+            } else {
+                span.left = std::min<uint16_t>(span.left, left);
+                span.right = std::max<uint16_t>(span.right, right);
+            }
+        }
+    }
+
+public:
+    ~FramePipeline() {
+        for (auto &job : jobs) delete[] job.body;
+        delete[] front;
+    }
+
+    // Allocates one job first, then the front frame, then the remaining jobs.
+    // Dirty spans are tracked per bandHeight rows.
+    void init(int bodySize, int frameSize, int bandHeight) {
+        this->bandHeight = bandHeight;
+        auto allocateJob = [&]() {
+            auto &job = jobs[jobSlots];
+            job.body = new (std::nothrow) uint8_t[bodySize];
+            if (!job.body) return false;
+            job.capacity = bodySize;
+            jobSlots++;
+            return true;
+        };
+        allocateJob();
+        front = new (std::nothrow) uint8_t[frameSize];
+        while (jobSlots < jobCount && allocateJob());
+        printf("frame pipeline: %d jobs, %s buffered\n", jobSlots, front ? "double" : "single");
+    }
+    bool isDoubleBuffered() const {
+        return front != nullptr;
+    }
+
+    // Free job for the fetch stage, nullptr if the render stage is behind.
+    Job *acquire(Date target) {
+        for (int i = 0; i < jobSlots; i++) {
+            bool expected = false;
+            if (!jobs[i].inUse.compare_exchange_strong(expected, true)) continue;
+            jobs[i].realtimeSize = 0;
+            jobs[i].psWaveSize = 0;
+            jobs[i].target = target;
+            return &jobs[i];
+        }
+        dropped++;
+        return nullptr;
+    }
+    void release(Job *job) {
+        job->inUse = false;
+    }
+
+    // Frame access of the display and the render stage.
+    bool lock(TickType_t wait = portMAX_DELAY) {
+        return mutex.take(wait);
+    }
+    void unlock() {
+        mutex.give();
+    }
+    // Called by the render stage with a finished frame in its work buffer. In single buffer mode
+    // the render stage holds the lock while it renders, and the lock is released here.
+    void publish(uint8_t *pixels, int width, int height, Date target) {
+        publish(pixels, width, height, target, [](const uint8_t *shown, const uint8_t *next) {});
+    }
+    // onSwap(shown, next) is called with the lock held before the front frame is replaced, shown is
+    // nullptr in single buffer mode or without a shown frame of the same size.
+    template<class F>
+    void publish(uint8_t *pixels, int width, int height, Date target, F &&onSwap) {
+        if (front) {
+            lock();
+            onSwap(latest(width, height), (const uint8_t*)pixels);
+            diff(pixels, width, height);
+            memcpy(front, pixels, width * height);
+        } else {
+            onSwap(nullptr, (const uint8_t*)pixels);
+            dirtyAll = true; // the previous frame was overwritten in place
+        }
+        frame = front ? front : pixels;
+        frameWidth = width;
+        frameHeight = height;
+        frameTarget = target;
+        unlock();
+    }
+    void invalidate() {
+        lock();
+        frame = nullptr;
+        dirtyAll = true;
+        unlock();
+    }
+    // Latest frame if it matches the size, to be called with the lock held.
+    const uint8_t *latest(int width, int height) const {
+        if (!frame || frameWidth != width || frameHeight != height) return nullptr;
+        return frame;
+    }
+    // Front frame for changes in place between publishes, nullptr in single buffer mode. To be
+    // called with the lock held, changed pixels are reported with markDirty.
+    uint8_t *mutableLatest(int width, int height) {
+        if (!front || frame != front || frameWidth != width || frameHeight != height) return nullptr;
+        return front;
+    }
+    void markDirty(int x, int y) {
+        if (y >= maxBands * bandHeight) {
+            dirtyAll = true;
+            return;
+        }
+        auto &span = dirty[y / bandHeight];
+        if (span.empty()) {
+            span = { (uint16_t)x, (uint16_t)(x + 1) };
+        } else {
+            span.left = std::min<uint16_t>(span.left, x);
+            span.right = std::max<uint16_t>(span.right, x + 1);
+        }
+    }
+    // Moves the dirty spans since the last call into spans, returns true if everything changed.
+    // To be called with the lock held.
+    bool takeDirty(Span (&spans)[maxBands]) {
+        bool all = dirtyAll;
+        for (int i = 0; i < maxBands; i++) {
+            spans[i] = dirty[i];
+            dirty[i] = Span();
+        }
+        dirtyAll = false;
+        return all;
+    }
+    // Pixels pushed by a display frame and the time spent waiting for the transfers.
+    void recordPushed(uint32_t pixels, bool full, int64_t wait) {
+        portENTER_CRITICAL(&statsLock);
+        displayFrames++;
+        pushWait += wait;
+        if (full) fullFrames++;
+        pushedPixels += pixels;
+        if (pixels > maxPushedPixels) maxPushedPixels = pixels;
+        portEXIT_CRITICAL(&statsLock);
+    }
+
+    void record(Stage stage, Date start) {
+        uint32_t elapsed = Date() - start;
+        portENTER_CRITICAL(&statsLock);
+        auto &stat = stats[stage];
+        stat.runs++;
+        stat.busy += elapsed;
+        if (elapsed > stat.max) stat.max = elapsed;
+        portEXIT_CRITICAL(&statsLock);
+    }
+    // Prints the share of time each stage was busy since the last report.
+    void print() {
+        Date now;
+        uint32_t period = now - statsStart;
+        if (period == 0) return;
+        StageStats stages[StageCount];
+        portENTER_CRITICAL(&statsLock);
+        for (int i = 0; i < StageCount; i++) {
+            stages[i] = stats[i];
+            stats[i] = StageStats();
+        }
+        uint32_t frames = displayFrames, full = fullFrames, pixels = pushedPixels, maxPixels = maxPushedPixels;
+        int64_t wait = pushWait;
+        displayFrames = fullFrames = pushedPixels = maxPushedPixels = 0;
+        pushWait = 0;
+        portEXIT_CRITICAL(&statsLock);
+        statsStart = now;
+
+        printf("frame pipeline (%s buffered): dropped %u\n", front ? "double" : "single", (unsigned)dropped);
+        for (int i = 0; i < StageCount; i++) {
+            auto &stat = stages[i];
+            printf("  %-8s occupancy %3u%%, runs %u, avg %ums, max %ums\n", stageNames[i], (unsigned)(stat.busy * 100 / period),
+                (unsigned)stat.runs, (unsigned)(stat.runs ? stat.busy / stat.runs : 0), (unsigned)stat.max);
+        }
+        printf("  pushed   avg %u px/frame, max %u px, full %u/%u frames, transfer wait avg %uus\n",
+            (unsigned)(frames ? pixels / frames : 0), (unsigned)maxPixels, (unsigned)full,
+            (unsigned)frames, (unsigned)(frames ? wait / frames : 0));
+    }
+};
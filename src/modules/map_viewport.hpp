@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include "esp_timer.h"
+#include "rtos.hpp"
+#include "types.hpp"
+#include "Bilinear.hpp"
+#include "BRLE.hpp"
+#include "date.hpp"
+#include "config/layout_config.hpp"
+#include "config/server_config.hpp"
+
+// Zoom and pan state of the map. A zoomed view is a window of the layout size over a virtual
+// image of the layout size times the zoom, which covers the whole source image.
+// Changed from the UI task, read by the render stage and the display.
+class MapViewport : private NoMove {
+public:
+    enum Direction { Up, Right, Down, Left, DirectionCount };
+    static constexpr const char *directionLabels[DirectionCount] = { "▲", "▶", "▼", "◀" };
+
+    struct View {
+        int zoom = 1;
+        int width = 0, height = 0;   // virtual image
+        int originX = 0, originY = 0; // top left of the window in the virtual image
+        uint32_t generation = 0;      // changes with every zoom or pan
+
+        bool isFit() const { return zoom == 1; }
+    };
+
+private:
+    static constexpr int sourceWidth = SERVER_CONFIG.imgWidth, sourceHeight = SERVER_CONFIG.imgHeight;
+    RTOS::Semaphore mutex = RTOS::Semaphore::mutex();
+    int zoomIndex = 0;
+    int centerX = sourceWidth / 2, centerY = sourceHeight / 2; // source pixels
+    uint32_t generation = 0;
+
+    // Keeps the window inside the source image.
+    void clampCenter() {
+        int zoom = MAP_ZOOM_LEVELS[zoomIndex];
+        int halfWidth = sourceWidth / zoom / 2, halfHeight = sourceHeight / zoom / 2;
+        centerX = std::clamp(centerX, halfWidth, sourceWidth - halfWidth);
+        centerY = std::clamp(centerY, halfHeight, sourceHeight - halfHeight);
+    }
+
+public:
+    // View for a layout of width x height.
+    View view(int width, int height) {
+        mutex.take();
+        View view;
+        view.zoom = MAP_ZOOM_LEVELS[zoomIndex];
+        view.width = width * view.zoom;
+        view.height = height * view.zoom;
+        view.originX = std::clamp(centerX * view.width / sourceWidth - width / 2, 0, view.width - width);
+        view.originY = std::clamp(centerY * view.height / sourceHeight - height / 2, 0, view.height - height);
+        view.generation = generation;
+        mutex.give();
+        return view;
+    }
+    int zoom() {
+        mutex.take();
+        int zoom = MAP_ZOOM_LEVELS[zoomIndex];
+        mutex.give();
+        return zoom;
+    }
+    bool isMaxZoom() {
+        mutex.take();
+        bool max = zoomIndex == MAP_ZOOM_LEVEL_COUNT - 1;
+        mutex.give();
+        return max;
+    }
+
+    // Next zoom level around the same center, back to the whole map after the last one.
+    void zoomIn() {
+        mutex.take();
+        zoomIndex = (zoomIndex + 1) % MAP_ZOOM_LEVEL_COUNT;
+        if (zoomIndex == 0) {
+            centerX = sourceWidth / 2;
+            centerY = sourceHeight / 2;
+        }
+        clampCenter();
+        generation++;
+        mutex.give();
+    }
+    // Returns false if the view is already at the edge.
+    bool pan(Direction direction) {
+        mutex.take();
+        int zoom = MAP_ZOOM_LEVELS[zoomIndex];
+        int x = centerX, y = centerY;
+        int stepX = sourceWidth / zoom / MAP_PAN_DIVISION, stepY = sourceHeight / zoom / MAP_PAN_DIVISION;
+        switch (direction) {
+        case Up: centerY -= stepY; break;
+        case Right: centerX += stepX; break;
+        case Down: centerY += stepY; break;
+        case Left: centerX -= stepX; break;
+        default: break;
+        }
+        clampCenter();
+        bool moved = x != centerX || y != centerY;
+        if (moved) generation++;
+        mutex.give();
+        return moved;
+    }
+    void reset() {
+        mutex.take();
+        zoomIndex = 0;
+        centerX = sourceWidth / 2;
+        centerY = sourceHeight / 2;
+        generation++;
+        mutex.give();
+    }
+};
+
+// Base map tiles of zoomed views, resampled from the original size RGB565 image and kept as the
+// byte swapped RGB565 the display expects. The tiles are allocated while a zoomed view is shown.
+// Without memory for them, the base map is resampled straight into the destination.
+// Used from the display only.
+class MapTileCache : private NoMove {
+    static constexpr int sourceWidth = SERVER_CONFIG.imgWidth, sourceHeight = SERVER_CONFIG.imgHeight;
+    static constexpr int tileSize = MAP_TILE_WIDTH * MAP_TILE_HEIGHT;
+    struct Key {
+        uint16_t width = 0, height = 0; // virtual image, 0 if the slot is empty
+        uint16_t x = 0, y = 0;          // tile column and row
+        uint32_t lastUsed = 0;
+    };
+    uint16_t *pixels = nullptr;
+    Key keys[MAP_TILE_CAPACITY];
+    uint32_t clock = 0, hits = 0, misses = 0, evictions = 0;
+    int64_t resampleTime = 0; // usec
+
+    struct Sampler {
+        const uint16_t *source;
+        uint32_t stepX, stepY; // 16.16 source pixels per virtual pixel
+        int width, height;
+        Sampler(const uint16_t *source, const MapViewport::View &view) : source(source), width(view.width), height(view.height) {
+            stepX = ((uint32_t)sourceWidth << 16) / view.width;
+            stepY = ((uint32_t)sourceHeight << 16) / view.height;
+        }
+        uint16_t operator()(int x, int y) const {
+            if (x >= width || y >= height) return 0;
+            uint16_t value = Bilinear::sample565(source, sourceWidth, sourceHeight, x * stepX, y * stepY);
+            return (value >> 8) | ((value & 0xff) << 8);
+        }
+    };
+
+    const uint16_t *tile(const Sampler &sample, int x, int y) {
+        if (!pixels) {
+            pixels = new (std::nothrow) uint16_t[tileSize * MAP_TILE_CAPACITY];
+            if (!pixels) return nullptr;
+        }
+        clock++;
+        Key *slot = nullptr;
+        for (auto &key : keys) {
+            if (key.width == sample.width && key.height == sample.height && key.x == x && key.y == y) {
+                hits++;
+                key.lastUsed = clock;
+                return &pixels[(&key - keys) * tileSize];
+            }
+            if (!slot || (slot->width && (!key.width || key.lastUsed < slot->lastUsed))) slot = &key;
+        }
+        misses++;
+        if (slot->width) evictions++;
+        *slot = { (uint16_t)sample.width, (uint16_t)sample.height, (uint16_t)x, (uint16_t)y, clock };
+        uint16_t *tile = &pixels[(slot - keys) * tileSize];
+        int64_t start = esp_timer_get_time();
+        for (int row = 0; row < MAP_TILE_HEIGHT; row++) {
+            for (int column = 0; column < MAP_TILE_WIDTH; column++) {
+                tile[row * MAP_TILE_WIDTH + column] = sample(x * MAP_TILE_WIDTH + column, y * MAP_TILE_HEIGHT + row);
+            }
+        }
+        resampleTime += esp_timer_get_time() - start;
+        return tile;
+    }
+
+public:
+    ~MapTileCache() {
+        delete[] pixels;
+    }
+
+    // Copies the base map of the width x height rect at left, top of the window into dst.
+    void fill(uint16_t *dst, int dstStride, const uint16_t *source, const MapViewport::View &view, int left, int top, int width, int height) {
+        Sampler sample(source, view);
+        int x0 = view.originX + left, y0 = view.originY + top;
+        for (int y = y0 / MAP_TILE_HEIGHT; y * MAP_TILE_HEIGHT < y0 + height; y++) {
+            for (int x = x0 / MAP_TILE_WIDTH; x * MAP_TILE_WIDTH < x0 + width; x++) {
+                const uint16_t *tile = this->tile(sample, x, y);
+                int fromX = std::max(x0, x * MAP_TILE_WIDTH), toX = std::min(x0 + width, (x + 1) * MAP_TILE_WIDTH);
+                int fromY = std::max(y0, y * MAP_TILE_HEIGHT), toY = std::min(y0 + height, (y + 1) * MAP_TILE_HEIGHT);
+                for (int row = fromY; row < toY; row++) {
+                    uint16_t *out = &dst[(row - y0) * dstStride + fromX - x0];
+                    if (tile) {
+                        memcpy(out, &tile[(row - y * MAP_TILE_HEIGHT) * MAP_TILE_WIDTH + fromX - x * MAP_TILE_WIDTH], (toX - fromX) * sizeof(uint16_t));
+                    } else {
+                        for (int column = fromX; column < toX; column++) *out++ = sample(column, row);
+                    }
+                }
+            }
+        }
+    }
+
+    // Drops the tiles, for a new base map or when the whole map is shown again.
+    void clear() {
+        delete[] pixels;
+        pixels = nullptr;
+        for (auto &key : keys) key = Key();
+    }
+
+    void print() {
+        printf("map tiles: %s, hits %u, misses %u, evictions %u, resample avg %uus\n", pixels ? "allocated" : "released",
+            (unsigned)hits, (unsigned)misses, (unsigned)evictions, (unsigned)(misses ? resampleTime / misses : 0));
+        hits = misses = evictions = 0;
+        resampleTime = 0;
+    }
+};
+
+// The last decoded overlay at the source size, so a zoom or pan resamples it at once instead of
+// waiting for the next update. The resize writes over the decoded image, a copy of it would not
+// fit in memory next to it, but the overlay is mostly transparent and its runs take a fraction.
+// Used from the render stage only.
+class KeptOverlay : private NoMove {
+    static constexpr int length = SERVER_CONFIG.imgWidth * SERVER_CONFIG.imgHeight;
+    uint8_t *encoded = nullptr;
+    int size = -1; // -1 if none is kept
+    Date target = Date(0);
+    uint32_t stores = 0, overflows = 0, restores = 0;
+    int maxSize = 0;
+
+public:
+    ~KeptOverlay() {
+        delete[] encoded;
+    }
+
+    // Keeps the decoded image of target, transparent pixels are 255.
+    void store(const uint8_t *image, Date target) {
+        if (!encoded) {
+            encoded = new (std::nothrow) uint8_t[KEPT_OVERLAY_CAPACITY];
+            if (!encoded) return;
+        }
+        size = BRLE::encode(image, length, 255, encoded, KEPT_OVERLAY_CAPACITY);
+        this->target = target;
+        stores++;
+        if (size < 0) overflows++;
+        maxSize = std::max(maxSize, size);
+    }
+
+    // Writes the kept image back, returns false if none is kept.
+    bool restore(uint8_t *image) {
+        if (size < 0) return false;
+        BRLE::decode(encoded, size, 255, image);
+        restores++;
+        return true;
+    }
+    Date keptTarget() const {
+        return target;
+    }
+
+    // Forgets the image, for a new base map region.
+    void clear() {
+        size = -1;
+    }
+
+    void print() {
+        printf("kept overlay: %u stores, overflows %u, restores %u, max %d/%d bytes\n", (unsigned)stores, (unsigned)overflows,
+            (unsigned)restores, maxSize, KEPT_OVERLAY_CAPACITY);
+        stores = overflows = restores = 0;
+        maxSize = 0;
+    }
+};
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include "esp_timer.h"
+#include "rtos.hpp"
+#include "date.hpp"
+#include "networking.hpp"
+#include "config/server_config.hpp"
+
+// Sends each request to the preferred mirror, and races it against the next mirror
+// once the request takes longer than the preferred mirror's usual latency.
+class MirrorClient : private NoMove {
+public:
+    struct MirrorStats {
+        uint32_t requests = 0;
+        uint32_t hedges = 0;
+        uint32_t wins = 0;
+        Networking::LatencyHistogram latency;
+    };
+
+private:
+    struct Mirror {
+        Networking::HTTPClient *client = nullptr;
+        std::unique_ptr<Networking::HTTPClient> ownedClient;
+        std::unique_ptr<RTOS::Task<portMAX_DELAY>> task;
+        std::atomic<uint32_t> launched = 0;  // generation of the last request sent to the task
+        std::atomic<uint32_t> completed = 0; // generation of the last request the task finished or skipped
+        std::atomic<uint32_t> cancelled = 0; // generation of the last cancelled request
+        bool success = false;
+        int latency = 0;
+        MirrorStats stats;
+        Networking::HTTPStats http[HTTPEndpoint::count]; // written by the mirror task only
+    };
+    static constexpr const char *taskNames[SERVER_MIRROR_MAX] = { "mirror0", "mirror1", "mirror2", "mirror3" };
+    const ServerConfig *config = &SERVER_CONFIG;
+    int mirrorCount = 0;
+    Mirror mirrors[SERVER_MIRROR_MAX];
+    std::atomic<uint32_t> generation = 0;
+    RTOS::Semaphore completion = RTOS::Semaphore::counting(SERVER_MIRROR_MAX * 4, 0);
+
+    std::string url(int index, const std::string &path) const {
+        return config->mirrors[index].baseUrl + path;
+    }
+
+    // Mirror task. Every request sent to the task is marked completed, also when it is skipped,
+    // so the client is known to be idle once completed catches up with launched.
+    void run(int index, uint32_t current, HTTPEndpoint endpoint, std::string path, Date deadline) {
+        auto &mirror = mirrors[index];
+        bool success = false;
+        Date start;
+        if (generation == current && mirror.cancelled != current) {
+            int remaining = deadline - start;
+            if (remaining > 0) {
+                mirror.client->cancelled = false;
+                mirror.client->stats = &mirror.http[endpoint.value];
+                mirror.client->setTimeout(remaining);
+                mirror.client->setDeadline(esp_timer_get_time() + remaining * 1000LL);
+                success = mirror.client->get(url(index, path));
+            }
+        }
+        mirror.success = success;
+        mirror.latency = Date() - start;
+        mirror.completed = current;
+        // losers finishing after get() returned would leave tokens for the next request
+        if (generation == current) completion.give();
+    }
+
+public:
+    void start(Networking::HTTPClient &primary, int bufferSize, const ServerConfig &serverConfig = SERVER_CONFIG) {
+        config = &serverConfig;
+        mirrorCount = config->mirrorCount();
+        for (int i = 0; i < mirrorCount; i++) {
+            auto &mirror = config->mirrors[i];
+            if (!mirror.address) continue;
+            std::string host = mirror.baseUrl;
+            host = host.substr(host.find("://") + 3);
+            host = host.substr(0, host.find_first_of(":/"));
+            Networking::setStaticAddress(host, mirror.address);
+        }
+        mirrors[0].client = &primary;
+        for (int i = 1; i < mirrorCount; i++) {
+            mirrors[i].ownedClient = std::make_unique<Networking::HTTPClient>(bufferSize);
+            mirrors[i].client = mirrors[i].ownedClient.get();
+            mirrors[i].client->clearBuffer();
+        }
+        if (mirrorCount < 2) return;
+        for (int i = 0; i < mirrorCount; i++) {
+            mirrors[i].task = std::make_unique<RTOS::Task<portMAX_DELAY>>(taskNames[i]);
+            mirrors[i].task->createQueue(4);
+            mirrors[i].task->start(RTOS::TaskPriority::Normal, 1024 * 4, 1);
+        }
+    }
+
+    // Returns the client holding the winning response, nullptr if no mirror responded in time.
+    // The response stays valid until the next call.
+    Networking::HTTPClient *get(HTTPEndpoint endpoint, const std::string &path, Date deadline) {
+        if (mirrorCount < 2) {
+            auto &mirror = mirrors[0];
+            int remaining = deadline - Date();
+            if (remaining <= 0) return nullptr;
+            Date start;
+            mirror.stats.requests++;
+            mirror.client->cancelled = false;
+            mirror.client->stats = &mirror.http[endpoint.value];
+            mirror.client->setTimeout(remaining);
+            mirror.client->setDeadline(esp_timer_get_time() + remaining * 1000LL);
+            if (!mirror.client->get(url(0, path))) return nullptr;
+            mirror.stats.wins++;
+            mirror.stats.latency.add(Date() - start);
+            return mirror.client;
+        }
+
+        uint32_t current = ++generation;
+        while (completion.take(0)); // a token that slips in after this only costs one more pass below
+        Date start;
+        int hedgeDelay = std::max<int>(config->hedgeMinDelay, mirrors[0].stats.latency.percentile(config->hedgePercentile));
+        int started = 0, finished = 0, winner = -1, fallback = -1;
+        bool done[SERVER_MIRROR_MAX] = {};
+        auto launch = [&]() {
+            int index = started++;
+            mirrors[index].stats.requests++;
+            if (index > 0) mirrors[index].stats.hedges++;
+            mirrors[index].launched = current;
+            mirrors[index].task->send([this, index, current, endpoint, path, deadline]() {
+                run(index, current, endpoint, path, deadline);
+            });
+        };
+
+        launch();
+        while (winner < 0) {
+            Date now;
+            if (now >= deadline) break;
+            int wait = deadline - now;
+            if (started < mirrorCount) wait = std::min<int>(wait, std::max<int>(0, hedgeDelay * started - (now - start)));
+            completion.take(pdMS_TO_TICKS(wait));
+
+            for (int i = 0; i < started; i++) {
+                auto &mirror = mirrors[i];
+                if (done[i] || mirror.completed != current) continue;
+                done[i] = true;
+                finished++;
+                if (!mirror.success) continue;
+                mirror.stats.latency.add(mirror.latency);
+                if (mirror.client->statusCode() == 200) {
+                    if (winner < 0) winner = i;
+                } else if (fallback < 0) {
+                    fallback = i;
+                }
+            }
+            if (winner >= 0) break;
+            if (started < mirrorCount && (finished == started || Date() - start >= hedgeDelay * started)) {
+                launch(); // the running mirrors failed or are slow, race the next one
+            } else if (finished == started) {
+                break;
+            }
+        }
+
+        for (int i = 0; i < started; i++) {
+            if (done[i] || i == winner) continue;
+            mirrors[i].cancelled = current;
+            mirrors[i].client->cancel();
+        }
+        if (winner >= 0) {
+            mirrors[winner].stats.wins++;
+            return mirrors[winner].client;
+        }
+        return fallback >= 0 ? mirrors[fallback].client : nullptr;
+    }
+
+    // True once every request sent to the mirror tasks has returned. Cancelled losers keep running
+    // on their task until the client notices the cancel, which can be after get() returned.
+    bool isIdle() const {
+        for (int i = 0; i < mirrorCount; i++) {
+            if (mirrors[i].completed != mirrors[i].launched) return false;
+        }
+        return true;
+    }
+
+    // Drops the connections of all mirrors. Returns false and keeps them while a request is still
+    // running, the caller retries later. Must not race with get().
+    bool reset() {
+        if (!isIdle()) return false;
+        for (int i = 0; i < mirrorCount; i++) mirrors[i].client->reset();
+        return true;
+    }
+
+    // Base URL of the preferred mirror, used for one-off downloads.
+    std::string primaryUrl(const std::string &path) const {
+        return url(0, path);
+    }
+
+    const MirrorStats &stats(int index) const {
+        return mirrors[index].stats;
+    }
+
+    const Networking::HTTPStats &httpStats(int index, HTTPEndpoint endpoint) const {
+        return mirrors[index].http[endpoint.value];
+    }
+
+    void print() const {
+        for (int i = 0; i < mirrorCount; i++) {
+            for (int j = 0; j < HTTPEndpoint::count; j++) {
+                char name[32];
+                if (mirrorCount < 2) snprintf(name, sizeof(name), "%s", identifier(HTTPEndpoint(j)));
+                else snprintf(name, sizeof(name), "%s@mirror%d", identifier(HTTPEndpoint(j)), i);
+                if (mirrors[i].http[j].requests) mirrors[i].http[j].print(name);
+            }
+            auto &stats = mirrors[i].stats;
+            printf("mirror %s: requests %u, hedges %u, wins %u (%u%%), latency avg %u p50 %u p90 %u\n",
+                config->mirrors[i].baseUrl, (unsigned)stats.requests, (unsigned)stats.hedges, (unsigned)stats.wins,
+                (unsigned)(stats.requests ? stats.wins * 100 / stats.requests : 0), (unsigned)stats.latency.average(),
+                (unsigned)stats.latency.percentile(50), (unsigned)stats.latency.percentile(90));
+        }
+    }
+};
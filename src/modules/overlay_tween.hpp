@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include "date.hpp"
+#include "types.hpp"
+#include "config/layout_config.hpp"
+#include "modules/frame_pipeline.hpp"
+
+// Color scale of the realtime images from the lowest to the highest intensity, RGB888 key colors.
+inline constexpr uint32_t INTENSITY_SCALE_KEYS[] = {
+    0x0000cd, 0x0040ff, 0x00a0ff, 0x00dcb4, 0x00f028, 0xa0f000,
+    0xffe600, 0xff9600, 0xff3c00, 0xdc0000, 0x8c0000,
+};
+
+// Ranks along the intensity scale. Realtime image colors are mapped to the nearest rank, colors far
+// from the scale like the base map have none.
+struct IntensityScale {
+    static constexpr int steps = 64;
+    static constexpr uint8_t none = 255;
+    uint8_t color[steps]; // RGB332 color of a rank
+    uint8_t rank[256];    // rank of an RGB332 color
+
+    constexpr IntensityScale() : color(), rank() {
+        constexpr int keys = sizeof(INTENSITY_SCALE_KEYS) / sizeof(INTENSITY_SCALE_KEYS[0]);
+        int rgb[steps][3] = {};
+        for (int i = 0; i < steps; i++) {
+            int position = i * (keys - 1) * 256 / (steps - 1);
+            int key = std::min(position >> 8, keys - 2), fraction = position - key * 256;
+            for (int c = 0; c < 3; c++) {
+                int a = (INTENSITY_SCALE_KEYS[key] >> (16 - c * 8)) & 0xff, b = (INTENSITY_SCALE_KEYS[key + 1] >> (16 - c * 8)) & 0xff;
+                rgb[i][c] = a + (b - a) * fraction / 256;
+            }
+            color[i] = (rgb[i][0] & 0b11100000) | ((rgb[i][1] >> 3) & 0b00011100) | (rgb[i][2] >> 6);
+        }
+        for (int value = 0; value < 256; value++) {
+            int r = (value >> 5) * 255 / 7, g = ((value >> 2) & 0b111) * 255 / 7, b = (value & 0b11) * 255 / 3;
+            int best = none, bestDistance = 3000; // about the quantization error of RGB332
+            for (int i = 0; i < steps; i++) {
+                int dr = r - rgb[i][0], dg = g - rgb[i][1], db = b - rgb[i][2];
+                int distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance) {
+                    best = i;
+                    bestDistance = distance;
+                }
+            }
+            rank[value] = best;
+        }
+    }
+};
+inline constexpr IntensityScale INTENSITY_SCALE;
+
+// Interpolates the map between two published frames. The render stage captures the pixels that
+// differ from the shown frame, and each display frame writes the next step of them into the front
+// frame in intensity rank space, so only those pixels are touched and pushed.
+// Pixels off the scale, like stations that appear or disappear, switch at the middle of the tween.
+// Both sides are called with the frame pipeline lock held.
+class OverlayTween : private NoMove {
+    struct Pixel {
+        uint16_t x, y;
+        uint8_t from, to;
+    };
+    Pixel *pixels = nullptr;
+    int count = 0;
+    int frames = 1, interval = 1000; // msec between steps
+    int shownStep = 0;
+    Date start = Date(0);
+    std::atomic<bool> running = false;
+    uint32_t tweens = 0, stepsShown = 0, pixelsCaptured = 0, overflows = 0;
+
+    static uint8_t blend(uint8_t from, uint8_t to, int step, int frames) {
+        int a = INTENSITY_SCALE.rank[from], b = INTENSITY_SCALE.rank[to];
+        if (a == IntensityScale::none || b == IntensityScale::none) return step * 2 >= frames ? to : from;
+        return INTENSITY_SCALE.color[a + (b - a) * step / frames];
+    }
+
+public:
+    ~OverlayTween() {
+        delete[] pixels;
+    }
+
+    // Render stage, before next replaces shown as the front frame.
+    void capture(TweenMode mode, const uint8_t *shown, const uint8_t *next, int width, int height) {
+        running = false;
+        count = 0;
+        auto &config = TWEEN_MODE_CONFIG[mode.value];
+        if (config.frames <= 1 || !shown) return;
+        if (!pixels) {
+            pixels = new (std::nothrow) Pixel[TWEEN_PIXEL_CAPACITY];
+            if (!pixels) return;
+        }
+        for (int y = 0; y < height; y++) {
+            const uint8_t *from = shown + y * width, *to = next + y * width;
+            if (memcmp(from, to, width) == 0) continue;
+            for (int x = 0; x < width; x++) {
+                if (from[x] == to[x]) continue;
+                if (count == TWEEN_PIXEL_CAPACITY) {
+                    overflows++;
+                    count = 0;
+                    return;
+                }
+                pixels[count++] = { (uint16_t)x, (uint16_t)y, from[x], to[x] };
+            }
+        }
+        if (count == 0) return;
+        frames = config.frames;
+        interval = 1000 / config.fps;
+        shownStep = 0;
+        start = Date(0);
+        tweens++;
+        pixelsCaptured += count;
+        running = true;
+    }
+
+    // Display, writes the step due at now into the front frame.
+    void step(FramePipeline &pipeline, int width, int height, Date now) {
+        if (!running) return;
+        uint8_t *frame = pipeline.mutableLatest(width, height);
+        if (!frame) {
+            running = false;
+            return;
+        }
+        if (!start) start = now;
+        int step = std::min<int>(frames, (now - start) / interval + 1);
+        if (step <= shownStep) return;
+        shownStep = step;
+        stepsShown++;
+        for (int i = 0; i < count; i++) {
+            auto &pixel = pixels[i];
+            uint8_t color = step >= frames ? pixel.to : blend(pixel.from, pixel.to, step, frames);
+            uint8_t &value = frame[pixel.y * width + pixel.x];
+            if (value == color) continue;
+            value = color;
+            pipeline.markDirty(pixel.x, pixel.y);
+        }
+        if (step >= frames) running = false;
+    }
+
+    bool isRunning() const {
+        return running;
+    }
+    int frameInterval() const {
+        return interval;
+    }
+
+    void print() {
+        printf("tween: %u tweens, %u steps, avg %u px, overflows %u\n", (unsigned)tweens, (unsigned)stepsShown,
+            (unsigned)(tweens ? pixelsCaptured / tweens : 0), (unsigned)overflows);
+        tweens = stepsShown = pixelsCaptured = overflows = 0;
+    }
+};
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <cstdio>
+#include <ctime>
+#include "types.hpp"
+#include "config/server_config.hpp"
+
+// Decides how the fetch stage recovers from updates that overran their second:
+// - SkipToLatest: the skipped seconds are lost, only counted.
+// - Backfill: the forecasts of the skipped seconds are fetched with the time left after later
+//   updates, so short-lived reports are not missed. Realtime images of past seconds are not.
+// - ReduceWork: the P/S-wave image is dropped until a run of updates finished in time.
+// Called from the fetch stage only.
+class OverrunPolicy : private NoMove {
+public:
+    static constexpr int backfillCapacity = 8;
+    static constexpr int recoveryUpdates = 5;
+
+private:
+    struct Counters {
+        uint32_t activations = 0; // times the mode kicked in
+        uint32_t seconds = 0;     // seconds skipped, backfilled or run with reduced work
+    };
+    Counters counters[OverrunMode::count];
+    uint32_t overruns = 0, skippedSeconds = 0, backfillDropped = 0;
+    time_t backfill[backfillCapacity];
+    int backfillCount = 0;
+    int onTime = recoveryUpdates;
+
+    void enterReduced() {
+        if (onTime >= recoveryUpdates) counters[OverrunMode::ReduceWork].activations++;
+        onTime = 0;
+    }
+
+public:
+    // Start of an update, with the seconds skipped since the previous one.
+    void begin(OverrunMode mode, time_t target, int skipped) {
+        if (mode != OverrunMode::ReduceWork) onTime = recoveryUpdates;
+        if (mode != OverrunMode::Backfill) backfillCount = 0;
+        if (skipped <= 0) return;
+        skippedSeconds += skipped;
+        switch (mode.value) {
+        case OverrunMode::SkipToLatest:
+            counters[mode.value].activations++;
+            counters[mode.value].seconds += skipped;
+            break;
+        case OverrunMode::Backfill:
+            counters[mode.value].activations++;
+            for (int i = skipped; i > 0; i--) {
+                if (backfillCount == backfillCapacity) {
+                    // keep the latest seconds
+                    for (int j = 1; j < backfillCount; j++) backfill[j - 1] = backfill[j];
+                    backfillCount--;
+                    backfillDropped++;
+                }
+                backfill[backfillCount++] = target - i * SERVER_CONFIG.updateInterval;
+            }
+            break;
+        case OverrunMode::ReduceWork:
+            enterReduced();
+            break;
+        default:
+            break;
+        }
+    }
+    // End of an update, overran if it finished after its deadline.
+    void end(OverrunMode mode, bool overran) {
+        if (overran) overruns++;
+        if (mode != OverrunMode::ReduceWork) return;
+        if (reduceWork()) counters[mode.value].seconds++;
+        if (overran) enterReduced();
+        else if (onTime < recoveryUpdates) onTime++;
+    }
+
+    bool reduceWork() const {
+        return onTime < recoveryUpdates;
+    }
+    // Oldest skipped second still to be fetched.
+    bool nextBackfill(time_t &target) {
+        if (backfillCount == 0) return false;
+        target = backfill[0];
+        for (int i = 1; i < backfillCount; i++) backfill[i - 1] = backfill[i];
+        backfillCount--;
+        counters[OverrunMode::Backfill].seconds++;
+        return true;
+    }
+
+    void print() {
+        printf("overrun: overruns %u, skipped seconds %u, backfill pending %d, dropped %u\n", (unsigned)overruns,
+            (unsigned)skippedSeconds, backfillCount, (unsigned)backfillDropped);
+        for (int i = 0; i < OverrunMode::count; i++) {
+            printf("  %-8s activations %u, seconds %u\n", identifier(OverrunMode(i)), (unsigned)counters[i].activations, (unsigned)counters[i].seconds);
+        }
+    }
+};
@@ -9,6 +9,7 @@
 #include "config/server_config.hpp"
 #include "config/layout_config.hpp"
 #include "config/sound_config.hpp"
+#include "config/location_config.hpp"
 #include "esp_err.h"
 
 class Settings {
@@ -42,6 +43,9 @@ public:
         restore<int16_t>("night_end"     , 7 * 60                         , [&](int16_t x) { nightEnd        = x;                                });
         restore<uint8_t>("mute_training" , true                           , [&](uint8_t x) { muteTraining    = x;                                });
         restore<uint8_t>("wifi_setup"    , false                          , [&](uint8_t x) { wifiSetup       = x;                                });
+        restore<uint8_t>("home_location" , 0                              , [&](uint8_t x) { homeLocation    = x < HOME_LOCATION_COUNT ? x : 0;  });
+        restore<uint8_t>("overrun_mode"  , OverrunMode::SkipToLatest      , [&](uint8_t x) { overrunMode     = OverrunMode(x);                   });
+        restore<uint8_t>("tween_mode"    , TweenMode::Off                 , [&](uint8_t x) { tweenMode       = TweenMode(x);                     });
     }
 
     MapRegion mapRegion;
@@ -132,4 +136,22 @@ public:
         wifiSetup = setup;
         nvs.set("wifi_setup", (uint8_t)setup);
     }
+
+    uint8_t homeLocation; // index of HOME_LOCATION_CONFIG, 0 for none
+    void setHomeLocation(uint8_t index) {
+        homeLocation = index;
+        nvs.set("home_location", index);
+    }
+
+    OverrunMode overrunMode;
+    void setOverrunMode(OverrunMode mode) {
+        overrunMode = mode;
+        nvs.set("overrun_mode", (uint8_t)mode.value);
+    }
+
+    TweenMode tweenMode;
+    void setTweenMode(TweenMode mode) {
+        tweenMode = mode;
+        nvs.set("tween_mode", (uint8_t)mode.value);
+    }
 };
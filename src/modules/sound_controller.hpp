@@ -5,15 +5,46 @@
 #pragma once
 #include <cstdint>
 #include "M5Unified.h"
-#include "date.hpp"
+#include "rtos.hpp"
+#include "ui.hpp"
 #include "config/sound_config.hpp"
 
 class SoundController {
 private:
     uint32_t repeat = 0, shortRepeat = 0, shortRepeatCount = 0;
-    Date shortIntervalTime = 0, longIntervalTime = 0;
     int shortInterval = 0, longInterval = 0;
     const uint8_t *playData = nullptr;
+    uint32_t session = 0;
+    RTOS::TimerId shortTimer, longTimer;
+
+    // The timers fire on the timer task, the speaker is driven from the UI task. Callbacks of a
+    // previous session that were already queued are ignored.
+    template<class F>
+    RTOS::TimerId every(int interval, F func) {
+        uint32_t session = this->session;
+        return RTOS::interval(interval, [this, session, func]() {
+            UI::send([this, session, func]() {
+                if (session == this->session && playData) func();
+            });
+        });
+    }
+    void startShortInterval() {
+        RTOS::cancel(shortTimer);
+        shortTimer = every(shortInterval, [this]() {
+            if (++shortRepeatCount < shortRepeat) {
+                playRepeat();
+                return;
+            }
+            RTOS::cancel(shortTimer);
+            if (longInterval <= 0) stop();
+        });
+    }
+    void cancelTimers() {
+        session++;
+        RTOS::cancel(shortTimer);
+        RTOS::cancel(longTimer);
+    }
+
 public:
     bool isPlaying() const {
         return playData != nullptr;
@@ -23,6 +54,7 @@ public:
         playWavInterval(config.data, config.repeat, config.shortInterval, config.shortRepeat, longRepeat ? config.longInterval : 0, volume);
     }
     void playWavInterval(const uint8_t *data, uint32_t repeat, int shortInterval, uint32_t shortRepeat, int longInterval, uint8_t volume) {
+        cancelTimers();
         M5.Speaker.stop();
         M5.Speaker.setVolume(volume);
         if (volume == 0) return;
@@ -32,15 +64,22 @@ public:
         this->repeat = repeat;
         this->shortRepeat = shortRepeat;
         this->shortRepeatCount = 0;
-        this->shortIntervalTime = this->longIntervalTime = Date();
         this->shortInterval = shortInterval;
         this->longInterval = longInterval;
         this->playData = data;
+        startShortInterval();
+        if (longInterval > 0) {
+            longTimer = every(longInterval, [this]() {
+                playRepeat();
+                shortRepeatCount = 0;
+                startShortInterval();
+            });
+        }
     }
     void stop() {
         if (isPlaying()) {
+            cancelTimers();
             repeat = shortRepeat = shortRepeatCount = 0;
-            shortIntervalTime = longIntervalTime = 0;
             shortInterval = longInterval = 0;
             playData = nullptr;
             M5.Speaker.setVolume(0);
@@ -52,24 +91,4 @@ public:
         M5.Speaker.tone(440, UINT32_MAX, 0, false);
         M5.Speaker.playWav(playData, ~0, repeat, 1, true);
     }
-    void eventLoop() {
-        auto now = Date();
-        if (!playData) return;
-        if (longInterval > 0 && now - longIntervalTime >= longInterval) {
-            playRepeat();
-            shortRepeatCount = 0;
-            shortIntervalTime = longIntervalTime = now;
-            return;
-        }
-        if (now - shortIntervalTime >= shortInterval) {
-            if (++shortRepeatCount < shortRepeat) {
-                playRepeat();
-                shortIntervalTime = now;
-            } else {
-                if (longInterval <= 0) {
-                    stop();
-                }
-            }
-        }
-    }
 };
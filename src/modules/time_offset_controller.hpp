@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include "date.hpp"
+#include "config/server_config.hpp"
+
+// Tracks whether the realtime image of each second was already published when it was requested,
+// and moves the fetch time offset as close to the server publication latency as possible.
+class TimeOffsetController {
+public:
+    static constexpr int windowSize = 60;
+    static constexpr int probeStreak = 30;
+
+    struct Sample {
+        int16_t age;      // msec elapsed from the target second when the server handled the request
+        int16_t response; // msec
+        bool published;
+    };
+
+private:
+    std::atomic<int> currentOffset = SERVER_CONFIG.timeOffset;
+    Sample samples[windowSize] = {};
+    int sampleCount = 0, sampleIndex = 0;
+    int successStreak = 0;
+    uint32_t publishedCount = 0, notFoundCount = 0;
+
+    static int clamp(int offset) {
+        // round towards the later fetch time
+        int step = SERVER_CONFIG.timeOffsetStep;
+        if (offset < 0) offset = -((-offset + step - 1) / step * step);
+        if (offset < SERVER_CONFIG.minTimeOffset) return SERVER_CONFIG.minTimeOffset;
+        if (offset > SERVER_CONFIG.maxTimeOffset) return SERVER_CONFIG.maxTimeOffset;
+        return offset;
+    }
+    void setOffset(int offset) {
+        offset = clamp(offset);
+        int prev = currentOffset.exchange(offset);
+        if (prev != offset) printf("timeOffset %d -> %d (latency %d-%d ms)\n", prev, offset, latencyLowerBound(), latencyUpperBound());
+    }
+
+public:
+    int offset() const {
+        return currentOffset;
+    }
+
+    // Latest age in the window at which a second was still not published, -1 if none.
+    int latencyLowerBound() const {
+        int bound = -1;
+        for (int i = 0; i < sampleCount; i++) {
+            if (!samples[i].published && samples[i].age > bound) bound = samples[i].age;
+        }
+        return bound;
+    }
+    // Earliest age in the window at which a second was already published, -1 if none.
+    int latencyUpperBound() const {
+        int bound = -1;
+        for (int i = 0; i < sampleCount; i++) {
+            if (samples[i].published && (bound < 0 || samples[i].age < bound)) bound = samples[i].age;
+        }
+        return bound;
+    }
+    int averageResponseTime() const {
+        if (sampleCount == 0) return 0;
+        int sum = 0;
+        for (int i = 0; i < sampleCount; i++) sum += samples[i].response;
+        return sum / sampleCount;
+    }
+
+    void record(Date target, Date requestStart, int statusCode, int responseTime) {
+        if (statusCode != 200 && statusCode != 404) return;
+        bool published = statusCode == 200;
+        int age = (requestStart - Date(target.epoch() * 1000)) + responseTime / 2;
+        samples[sampleIndex] = { (int16_t)age, (int16_t)responseTime, published };
+        sampleIndex = (sampleIndex + 1) % windowSize;
+        if (sampleCount < windowSize) sampleCount++;
+
+        int step = SERVER_CONFIG.timeOffsetStep;
+        int lowerBound = latencyLowerBound();
+        if (!published) {
+            notFoundCount++;
+            successStreak = 0;
+            // fetch at least one step later than the latest miss
+            int offset = currentOffset - step;
+            if (offset > -(lowerBound + step)) offset = -(lowerBound + step);
+            setOffset(offset);
+            return;
+        }
+
+        publishedCount++;
+        if (++successStreak < probeStreak) return;
+        successStreak = 0;
+        // probe one step earlier, but never at or before a miss still in the window
+        int offset = currentOffset + step;
+        if (lowerBound >= 0 && -offset <= lowerBound) return;
+        setOffset(offset);
+    }
+
+    void print() const {
+        printf("timeOffset: %d ms, latency: %d-%d ms, response: %d ms, 200: %u, 404: %u\n",
+            offset(), latencyLowerBound(), latencyUpperBound(), averageResponseTime(),
+            (unsigned)publishedCount, (unsigned)notFoundCount);
+    }
+};
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+// P/S-wave travel times from a hypocenter to the surface, tabulated at compile time.
+// The table comes from a two-layer crust/mantle model, a simplified stand-in for the JMA2001
+// tables used by the server, so fronts can differ from the server's by a few kilometers.
+namespace TravelTime {
+
+enum class Phase : uint8_t { P, S };
+
+struct Velocity {
+    double crust;
+    double mantle;
+};
+inline constexpr double CRUST_THICKNESS = 30; // km
+inline constexpr Velocity P_VELOCITY = { 6.0, 7.8 }; // km/s
+inline constexpr Velocity S_VELOCITY = { 3.5, 4.5 }; // km/s
+
+inline constexpr int DEPTH_COUNT = 16;
+inline constexpr int DEPTHS[DEPTH_COUNT] = { 0, 10, 20, 30, 40, 60, 80, 100, 150, 200, 250, 300, 400, 500, 600, 700 }; // km
+inline constexpr int DISTANCE_STEP = 10; // km
+inline constexpr int DISTANCE_COUNT = 101; // 0 - 1000 km
+inline constexpr int TIME_SCALE = 10; // table unit is 0.1 sec
+
+namespace detail {
+
+constexpr double sqrt(double value) {
+    if (value <= 0) return 0;
+    double x = 1;
+    while (x * x < value) x *= 2;
+    for (int i = 0; i < 8; i++) x = (x + value / x) / 2;
+    return x;
+}
+
+// Fastest of the direct and Moho-refracted rays for a source in the crust.
+constexpr double crustTime(double depth, double distance, Velocity v) {
+    double h = CRUST_THICKNESS;
+    double direct = sqrt(distance * distance + depth * depth) / v.crust;
+    double critical = (2 * h - depth) * v.crust / sqrt(v.mantle * v.mantle - v.crust * v.crust);
+    if (distance < critical) return direct;
+    double refracted = distance / v.mantle + (2 * h - depth) * sqrt(1 / (v.crust * v.crust) - 1 / (v.mantle * v.mantle));
+    return refracted < direct ? refracted : direct;
+}
+
+struct Table {
+    uint16_t time[2][DEPTH_COUNT][DISTANCE_COUNT];
+};
+
+// For a source in the mantle, rays are traced upward by their horizontal offset at the Moho
+// (refracted by Snell's law into the crust) and resampled onto the distance grid.
+constexpr void fillMantle(uint16_t *row, double depth, Velocity v) {
+    double h = CRUST_THICKNESS, mantle = depth - h;
+    double prevDistance = 0, prevTime = mantle / v.mantle + h / v.crust;
+    int index = 0;
+    row[index++] = (uint16_t)(prevTime * TIME_SCALE + 0.5);
+    for (double x = 1; index < DISTANCE_COUNT; x += 1) {
+        double path = sqrt(x * x + mantle * mantle);
+        double sinCrust = v.crust / v.mantle * x / path;
+        double cosCrust = sqrt(1 - sinCrust * sinCrust);
+        double distance = x + h * sinCrust / cosCrust;
+        double time = path / v.mantle + h / (v.crust * cosCrust);
+        while (index < DISTANCE_COUNT && index * DISTANCE_STEP <= distance) {
+            double t = (index * DISTANCE_STEP - prevDistance) / (distance - prevDistance);
+            row[index++] = (uint16_t)((prevTime + (time - prevTime) * t) * TIME_SCALE + 0.5);
+        }
+        prevDistance = distance;
+        prevTime = time;
+    }
+}
+
+constexpr Table build() {
+    Table table = {};
+    for (int d = 0; d < DEPTH_COUNT; d++) {
+        if (DEPTHS[d] > CRUST_THICKNESS) {
+            fillMantle(table.time[0][d], DEPTHS[d], P_VELOCITY);
+            fillMantle(table.time[1][d], DEPTHS[d], S_VELOCITY);
+            continue;
+        }
+        for (int i = 0; i < DISTANCE_COUNT; i++) {
+            table.time[0][d][i] = (uint16_t)(crustTime(DEPTHS[d], i * DISTANCE_STEP, P_VELOCITY) * TIME_SCALE + 0.5);
+            table.time[1][d][i] = (uint16_t)(crustTime(DEPTHS[d], i * DISTANCE_STEP, S_VELOCITY) * TIME_SCALE + 0.5);
+        }
+    }
+    return table;
+}
+
+}
+
+inline constexpr detail::Table TABLE = detail::build();
+
+// Table time at a distance index, interpolated between the tabulated depths.
+inline float tableTime(Phase phase, float depth, int index) {
+    auto &rows = TABLE.time[phase == Phase::P ? 0 : 1];
+    if (depth <= DEPTHS[0]) return rows[0][index];
+    for (int d = 1; d < DEPTH_COUNT; d++) {
+        if (depth > DEPTHS[d]) continue;
+        float t = (depth - DEPTHS[d - 1]) / (DEPTHS[d] - DEPTHS[d - 1]);
+        return rows[d - 1][index] + (rows[d][index] - rows[d - 1][index]) * t;
+    }
+    return rows[DEPTH_COUNT - 1][index];
+}
+
+// Seconds until the wave reaches the epicentral distance (km).
+inline float arrivalTime(Phase phase, float depth, float distance) {
+    float position = distance / DISTANCE_STEP;
+    if (position < 0) position = 0;
+    int index = (int)position;
+    if (index >= DISTANCE_COUNT - 1) {
+        // extrapolate with the slope of the last interval
+        float last = tableTime(phase, depth, DISTANCE_COUNT - 1), prev = tableTime(phase, depth, DISTANCE_COUNT - 2);
+        return (last + (last - prev) * (position - (DISTANCE_COUNT - 1))) / TIME_SCALE;
+    }
+    float a = tableTime(phase, depth, index), b = tableTime(phase, depth, index + 1);
+    return (a + (b - a) * (position - index)) / TIME_SCALE;
+}
+
+// Epicentral distance (km) the wave front has reached after the elapsed seconds, negative
+// while the wave has not reached the surface yet.
+inline float radius(Phase phase, float depth, float elapsed) {
+    float target = elapsed * TIME_SCALE;
+    float prev = tableTime(phase, depth, 0);
+    if (target < prev) return -1;
+    for (int i = 1; i < DISTANCE_COUNT; i++) {
+        float current = tableTime(phase, depth, i);
+        if (target <= current) {
+            float t = current > prev ? (target - prev) / (current - prev) : 0;
+            return (i - 1 + t) * DISTANCE_STEP;
+        }
+        prev = current;
+    }
+    return (DISTANCE_COUNT - 1) * DISTANCE_STEP;
+}
+
+// Great circle distance (km) between two points on the surface.
+inline float distance(float latitude1, float longitude1, float latitude2, float longitude2) {
+    constexpr float radian = (float)M_PI / 180, earthRadius = 6371;
+    float dLatitude = (latitude2 - latitude1) * radian, dLongitude = (longitude2 - longitude1) * radian;
+    float a = sinf(dLatitude / 2) * sinf(dLatitude / 2) + cosf(latitude1 * radian) * cosf(latitude2 * radian) * sinf(dLongitude / 2) * sinf(dLongitude / 2);
+    return 2 * earthRadius * asinf(sqrtf(a));
+}
+
+}
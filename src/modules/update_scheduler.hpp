@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <sys/time.h>
+#include "esp_timer.h"
+#include "types.hpp"
+#include "http_stats.hpp"
+#include "config/server_config.hpp"
+#include "modules/time_offset_controller.hpp"
+
+// Calls the handler at each update second of the target time (wall clock plus the time offset).
+// A one-shot esp_timer is re-armed for the next boundary every time it fires, so the phase
+// follows changes of the offset and adjustments of the wall clock.
+class UpdateScheduler : private NoMove {
+    const TimeOffsetController &offsetController;
+    esp_timer_handle_t timer = nullptr;
+    std::function<void(time_t)> handler;
+    std::atomic<bool> running = false;
+    int64_t ideal = 0;        // usec, wall clock time the pending fire is due
+    int64_t idealTarget = 0;  // usec, target time of the pending fire
+    // |actual - ideal| in units of jitterUnit usec, so the millisecond buckets span 100us to 20ms
+    Networking::LatencyHistogram jitter;
+    static constexpr int jitterUnit = 10;
+    uint32_t early = 0;
+
+    static int64_t wallClock() {
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+        return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    }
+
+    void arm() {
+        int64_t now = wallClock(), offset = offsetController.offset() * 1000LL;
+        int64_t interval = SERVER_CONFIG.updateInterval * 1000000LL;
+        int64_t target = ((now + offset) / interval + 1) * interval;
+        if (idealTarget && target <= idealTarget) target = idealTarget + interval; // fired early, do not repeat the boundary
+        idealTarget = target;
+        ideal = target - offset;
+        esp_timer_start_once(timer, ideal > now ? ideal - now : 0);
+    }
+
+    static void fire(void *arg) {
+        auto self = static_cast<UpdateScheduler *>(arg);
+        if (!self->running) return;
+        int64_t delta = wallClock() - self->ideal;
+        if (delta < 0) self->early++;
+        self->jitter.add((uint32_t)std::min<int64_t>(llabs(delta) / jitterUnit, UINT32_MAX));
+        time_t target = self->idealTarget / 1000000;
+        if (!self->running) return;
+        self->arm();
+        self->handler(target);
+    }
+
+public:
+    UpdateScheduler(const TimeOffsetController &offsetController) : offsetController(offsetController) {}
+    ~UpdateScheduler() {
+        stop();
+        if (timer) esp_timer_delete(timer);
+    }
+
+    // The handler runs on the esp_timer task and must not block.
+    void start(std::function<void(time_t)> handler) {
+        stop();
+        this->handler = handler;
+        if (!timer) {
+            esp_timer_create_args_t args = {};
+            args.callback = fire;
+            args.arg = this;
+            args.dispatch_method = ESP_TIMER_TASK;
+            args.name = "update";
+            esp_timer_create(&args, &timer);
+        }
+        idealTarget = 0;
+        running = true;
+        arm();
+    }
+    void stop() {
+        running = false;
+        if (timer) esp_timer_stop(timer);
+    }
+
+    void print() const {
+        printf("update timer: fires %u, jitter avg %uus p50 %uus p99 %uus max %uus, early %u\n",
+            (unsigned)jitter.count, (unsigned)(jitter.average() * jitterUnit), (unsigned)(jitter.percentile(50) * jitterUnit),
+            (unsigned)(jitter.percentile(99) * jitterUnit), (unsigned)(jitter.max * jitterUnit), (unsigned)early);
+    }
+};
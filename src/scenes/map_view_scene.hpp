@@ -3,37 +3,89 @@
  */
 
 #pragma once
+#include <atomic>
+#include <cmath>
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "kyoshin.hpp"
 #include "date.hpp"
+#include "trace.hpp"
+#include "system_monitor.hpp"
 #include "Bilinear.hpp"
+#include "Composite.hpp"
 #include "GIF.hpp"
 #include "config/layout_config.hpp"
 #include "modules/forecast.hpp"
+#include "modules/travel_time.hpp"
+#include "modules/arrival_countdown.hpp"
+#include "modules/update_scheduler.hpp"
+#include "modules/frame_pipeline.hpp"
+#include "modules/activity_policy.hpp"
+#include "modules/overrun_policy.hpp"
+#include "modules/forecast_panel.hpp"
+#include "modules/overlay_tween.hpp"
+#include "modules/map_viewport.hpp"
 #include "settings/settings_scene.hpp"
 #include "resources/fonts.hpp"
 
 class MapViewScene : public UI::Scene {
     shared_ptr<FlashImagePartition> flashImagePartition;
-    Forecast forecast;
-    bool updating = false;
-    time_t lastUpdated = 0;
+    // The fetch stage updates fetchedForecast under forecastLock, the UI task copies it into forecast
+    // when the version changed and only reads its copy. The render stage sees the layout through
+    // forecastShown.
+    Forecast fetchedForecast, forecast;
+    RTOS::Semaphore forecastLock = RTOS::Semaphore::mutex();
+    std::atomic<uint32_t> forecastVersion = 0;
+    uint32_t shownForecastVersion = 0;
+    std::atomic<bool> forecastShown = false;
+    ArrivalCountdown arrivalCountdown;
+    std::atomic<bool> updating = false;
+    std::atomic<time_t> lastUpdated = 0;
+    std::atomic<bool> displayIsOn = true;
+    std::atomic<uint32_t> abandonedUpdates = 0;
+    UpdateScheduler scheduler = UpdateScheduler(timeOffsetController);
+    FramePipeline pipeline;
+    ActivityPolicy activityPolicy;
+    OverrunPolicy overrunPolicy;
+    ForecastPanel forecastPanel;
+    OverlayTween tween;
+    MapViewport viewport;
+    MapTileCache tileCache;
+    KeptOverlay keptOverlay;
+    std::atomic<uint32_t> frameGeneration = 0; // viewport of the published frame
+    MapViewport::Direction panDirection = MapViewport::Right;
+    Date showNavigation = Date(0);
+    std::atomic<int> intensePixels = 0; // in the last realtime image
     int nextUpdateInterval = 0;
     Date showRealtimeImgTypeSwitch = Date(0);
-    Date displayOnTime = Date(0);
+    bool fullRedraw = true; // the map area was drawn over or its contents changed
+    const ViewLayoutConfig *shownLayout = nullptr;
+    bool frameShown = false, waveFrontsShown = false;
+    // Band buffers of display(), allocated once. The canvases wrap them to draw the wave fronts.
+    uint16_t *bandBuffers[2] = {};
+    M5Canvas bands[2];
+    bool bandDMA = true;
+    Date dimTimerArmed = Date(0);
+    RTOS::TimerId dimTimer, reconnectTimer;
+    int reconnectDelay = RECONNECT_DELAY_MIN;
+    static inline std::atomic<bool> reconnectPending = false;
+    static constexpr int RECONNECT_DELAY_MIN = 1000, RECONNECT_DELAY_MAX = 30000; // msec
+    Date lastWaveFrontFrame = Date(0);
+    Date lastTweenFrame = Date(0);
 
     const MapRegionConfig &regionConfig() const {
         return SERVER_CONFIG.regions[settings.mapRegion.value];
     }
-    const char *realtimeImgUrlFormat() const {
-        if (settings.borehole) return regionConfig().boreholeUrlFormats[settings.realtimeImgType.value];
-        return regionConfig().surfaceUrlFormats[settings.realtimeImgType.value];
+    const char *realtimeImgPathFormat() const {
+        if (settings.borehole) return regionConfig().boreholePathFormats[settings.realtimeImgType.value];
+        return regionConfig().surfacePathFormats[settings.realtimeImgType.value];
     }
     const ViewLayoutConfig &layoutConfig() const {
         auto &layoutModeConfig = VIEW_LAYOUT_MODE_CONFIG[settings.layoutMode.value];
-        auto layout = forecast.empty() ? layoutModeConfig.normal : layoutModeConfig.alert;
+        auto layout = forecastShown ? layoutModeConfig.alert : layoutModeConfig.normal;
         return VIEW_LAYOUT_CONFIG[layout.value];
     }
-    bool inNightMode() const {
+    static bool inNightMode() {
         if (!settings.useNightMode) return false;
         auto now = Date().localtime() / 60 % 1440;
         auto start = settings.nightStart, end = settings.nightEnd;
@@ -41,18 +93,72 @@ class MapViewScene : public UI::Scene {
         return now < end || start <= now;
     }
 
+public:
+    ~MapViewScene() {
+        for (auto &band : bands) band.deleteSprite();
+        for (auto buffer : bandBuffers) heap_caps_free(buffer);
+    }
+
+private:
+    void didLoad() override {
+        int frameSize = 0;
+        for (auto &layout : VIEW_LAYOUT_CONFIG) frameSize = std::max(frameSize, layout.imgWidth * layout.imgHeight);
+        pipeline.init(httpClient.bufferSize, frameSize, blockHeight);
+#ifdef KYOSHIN_SYNC_DISPLAY
+        printf("display: band buffers per frame, synchronous push\n");
+        bandDMA = false;
+#else
+        allocateBandBuffers(MALLOC_CAP_DMA);
+        if (!bandBuffers[0] || !bandBuffers[1]) {
+            // transfers from other memory are copied by the driver, so push synchronously
+            printf("display: no DMA capable memory for the band buffers\n");
+            bandDMA = false;
+            allocateBandBuffers(MALLOC_CAP_8BIT);
+        }
+#endif
+    }
+
+    // Allocates the missing band buffers.
+    void allocateBandBuffers(uint32_t caps) {
+        int bandWidth = 0;
+        for (auto &layout : VIEW_LAYOUT_CONFIG) bandWidth = std::max<int>(bandWidth, layout.imgWidth);
+        for (auto &buffer : bandBuffers) {
+            if (!buffer) buffer = (uint16_t*)heap_caps_malloc(bandWidth * blockHeight * sizeof(uint16_t), caps);
+        }
+    }
+
     void willAppear() override {
         M5.Display.setRotation(layoutConfig().rotation);
         flashImagePartition = flashImage.partition(regionConfig().identifier);
         prepareBaseMap();
-        memset(imgBuffer.u8, 255, sizeof(imgBuffer.u8));
+        pipeline.invalidate();
+        renderTask.send([this]() {
+            keptOverlay.clear(); // the region may have changed
+        });
+        fullRedraw = true;
+        forecastLock.take();
+        fetchedForecast.clear();
+        forecastLock.give();
+        forecastVersion++;
         forecast.clear();
+        forecastShown = false;
         displayOn(Date());
         nextUpdateInterval = 0;
+        scheduler.start([this](time_t target) {
+            scheduledUpdate(target);
+        });
+    }
+
+    void willDisappear() override {
+        scheduler.stop();
+        UI::setFrameInterval(ACTIVITY_STATE_CONFIG[ActivityState::Active].frameInterval);
+        RTOS::cancel(dimTimer);
+        if (RTOS::cancel(reconnectTimer)) reconnectPending = false;
     }
 
     void prepareBaseMap() {
         if (flashImagePartition->isInitialized()) return;
+        TRACE_SCOPE("prepareBaseMap");
 
         M5.Display.setCursor(0, 0);
         M5.Display.clear(TFT_WHITE);
@@ -63,7 +169,8 @@ class MapViewScene : public UI::Scene {
         Networking::HTTPClient httpClient([this](uint8_t *buffer, int offset, int length) {
             flashImagePartition->write(FlashImg::MapOriginalGif, offset, buffer, length);
         });
-        httpClient.get(regionConfig().baseMapUrl);
+        httpClient.stats = &baseMapStats;
+        httpClient.get(mirrorClient.primaryUrl(regionConfig().baseMapPath));
         M5.Display.println("Download base map done.");
 
         // 16bit/8bit Original Size
@@ -119,57 +226,106 @@ class MapViewScene : public UI::Scene {
     }
 
     void checkNetworkStatus() {
-        if (Networking::isNetworkConnected()) return;
+        if (Networking::isNetworkConnected()) {
+            reconnectDelay = RECONNECT_DELAY_MIN;
+            return;
+        }
         lastUpdated = 0;
+        fullRedraw = true;
         M5.Display.setCursor(0, 0);
         M5.Display.setTextColor(TFT_WHITE, TFT_BLACK);
         M5.Display.println("WiFi Disconnected.");
-        if (updating) return;
-        httpClient.reset();
-        if (!Networking::isWiFiConnecting() && !Networking::isWiFiConnected()) {
-            bgTask1.send([]() {
-                Networking::connect();
+        if (updating || !mirrorClient.reset()) return;
+        if (!reconnectPending && !Networking::isWiFiConnecting() && !Networking::isWiFiConnected()) {
+            // retry with backoff, the flag is cleared once the attempt has returned
+            reconnectPending = true;
+            reconnectTimer = RTOS::timeout(reconnectDelay, []() {
+                bool sent = bgTask1.send([]() {
+                    Networking::connect();
+                    reconnectPending = false;
+                }, 0);
+                if (!sent) reconnectPending = false;
             });
+            if (!reconnectTimer) reconnectPending = false;
+            reconnectDelay = std::min(reconnectDelay * 2, RECONNECT_DELAY_MAX);
         }
         M5.Display.println("Reconnecting...");
     }
 
+    // Re-arms the dim timer, at most once a second since this is called every loop during a forecast.
     void displayOn(Date now) {
-        displayOnTime = now;
         if (M5.Display.getBrightness() != settings.brightness) M5.Display.setBrightness(settings.brightness);
+        if (now - dimTimerArmed < 1000 && RTOS::timerWheel().isPending(dimTimer)) return;
+        dimTimerArmed = now;
+        RTOS::cancel(dimTimer);
+        dimTimer = RTOS::timeout(settings.dimDuration * 1000, []() {
+            UI::send([]() {
+                if (M5.Display.getBrightness() >= settings.brightness) displayOff(inNightMode());
+            });
+        });
     }
-    void displayOff(bool nightMode) {
+    static void displayOff(bool nightMode) {
         int16_t brightness = nightMode ? 0 : settings.dimBrightness;
         if (brightness < 0) return;
         if (M5.Display.getBrightness() != brightness) M5.Display.setBrightness(brightness);
     }
 
+    // Called on the esp_timer task at each update second.
+    void scheduledUpdate(time_t targetEpoch) {
+        if (updating || !lastUpdated || !Networking::isNetworkConnected()) return;
+        if (targetEpoch == lastUpdated) return;
+        startUpdate(targetEpoch);
+    }
+
+    void startUpdate(time_t targetEpoch) {
+        bool expected = false;
+        if (!updating.compare_exchange_strong(expected, true)) return;
+        time_t last = lastUpdated;
+        int skipped = last ? std::max<int>((targetEpoch - last) / SERVER_CONFIG.updateInterval - 1, 0) : 0;
+        lastUpdated = targetEpoch;
+        bool displayIsOn = this->displayIsOn;
+        Date target = Date(targetEpoch * 1000LL);
+        bool sent = bgTask1.send([this, target, displayIsOn, skipped]() {
+            update(target, displayIsOn, skipped);
+            updating = false;
+        }, 0);
+        if (!sent) {
+            abandonedUpdates++;
+            updating = false;
+        }
+    }
+
+    // Takes the forecast of the fetch stage once it changed.
+    void syncForecast() {
+        uint32_t version = forecastVersion;
+        if (version == shownForecastVersion) return;
+        forecastLock.take();
+        forecast.assign(fetchedForecast);
+        forecastLock.give();
+        shownForecastVersion = version;
+        forecastShown = !forecast.empty();
+    }
+
     void eventLoop() override {
         checkNetworkStatus();
+        syncForecast();
 
         auto now = Date();
-        Date target = now + SERVER_CONFIG.timeOffset;
+        Date target = now + timeOffsetController.offset();
         time_t targetEpoch = target.epoch();
-        bool shouldUpdate = false;
-        if (!updating) {
-            if (!Networking::isNetworkConnected()) shouldUpdate = false;
-            else if (!lastUpdated) shouldUpdate = true;
-            else if (target.msec() >= 500) shouldUpdate = false;
-            else if (targetEpoch % SERVER_CONFIG.updateInterval != 0) shouldUpdate = false;
-            else shouldUpdate = targetEpoch != lastUpdated;
-        }
-        if (shouldUpdate) {
-            bool displayIsOn = M5.Display.getBrightness() >= settings.brightness;
-            lastUpdated = targetEpoch;
-            updating = true;
-            bgTask1.send([this, target, displayIsOn]() {
-                update(target, displayIsOn);
-                UI::send([this]() {
-                    updating = false;
-                    setNeedsDisplay();
-                });
-            });
+        displayIsOn = M5.Display.getBrightness() >= settings.brightness;
+        // the first update starts right away, the following ones from the update scheduler
+        if (!updating && !lastUpdated && Networking::isNetworkConnected()) startUpdate(targetEpoch);
+
+        if (lastUpdated > 0 && forecast.isLocated() && now - lastWaveFrontFrame >= WAVE_FRONT_FRAME_INTERVAL) {
+            lastWaveFrontFrame = now;
+            setNeedsDisplay();
         }
+        if (tween.isRunning() && now - lastTweenFrame >= tween.frameInterval()) {
+            lastTweenFrame = now;
+            setNeedsDisplay();
+        }
+        if (arrivalCountdown.update(forecast, settings.homeLocation, now)) drawArrivalCountdown(now);
 
         bool shouldRing = false, nightMode = inNightMode();
         if (!forecast.empty()) {
@@ -200,7 +356,6 @@ class MapViewScene : public UI::Scene {
         } else {
             soundController.stop();
         }
-        soundController.eventLoop();
         forecast.updateReportTime();
 
         if (M5.Display.getBrightness() < settings.brightness) {
@@ -208,66 +363,230 @@ class MapViewScene : public UI::Scene {
             else displayOff(nightMode);
             return;
         }
-        if (!realtimeImgTypeSwitchButtonAction(now)) buttonAction(now);
-        if (now - displayOnTime > settings.dimDuration * 1000) displayOff(nightMode);
+        if (!realtimeImgTypeSwitchButtonAction(now) && !navigationButtonAction(now)) buttonAction(now);
+    }
+
+    // Wall clock time at which the next second becomes due and this one turns stale.
+    Date updateDeadline(Date target) const {
+        return Date((target.epoch() + SERVER_CONFIG.updateInterval) * 1000) - timeOffsetController.offset();
+    }
+
+    // GET from the mirrors with the remaining budget of the current second as timeout.
+    Networking::HTTPClient *fetch(HTTPEndpoint endpoint, const string &path, Date deadline) {
+        return mirrorClient.get(endpoint, path, deadline);
     }
 
-    void update(Date target, bool displayIsOn) {
+    // Fetch stage, runs on bgTask1 and hands the downloaded images to the render stage.
+    // skipped is the number of seconds skipped since the previous update.
+    void update(Date target, bool displayIsOn, int skipped) {
+        TRACE_SCOPE("fetch");
+        SystemMonitor::cycle();
         printf("update %s\n", target.strftime("%Y-%m-%d %H:%M:%S").c_str());
-        checkForecast(target);
+        if (target.epoch() % 60 == 0) {
+            timeOffsetController.print();
+            printf("abandoned updates: %u\n", (unsigned)abandonedUpdates);
+            overrunPolicy.print();
+            scheduler.print();
+            pipeline.print();
+            bgTask1.messageQueue()->print("bgTask1");
+            renderTask.messageQueue()->print("render");
+            if (auto queue = UI::messageQueue()) queue->print("ui");
+            RTOS::timerWheel().print();
+            activityPolicy.print();
+            SystemMonitor::print();
+            forecastPanel.print();
+            tween.print();
+            tileCache.print();
+            renderTask.send([this]() {
+                keptOverlay.print();
+            }, 0);
+            UI::send([]() {
+                UI::printTextAtlas(); // the atlas belongs to the UI task
+            });
+        }
+        if (target.epoch() % SERVER_CONFIG.statsInterval == 0) {
+            baseMapStats.print(identifier(HTTPEndpoint(HTTPEndpoint::BaseMap)));
+            mirrorClient.print();
+            TRACE_DUMP();
+        }
+        auto mode = settings.overrunMode;
+        overrunPolicy.begin(mode, target.epoch(), skipped);
+        Date deadline = updateDeadline(target);
+        fetchFrame(target, displayIsOn, deadline);
+        overrunPolicy.end(mode, Date() >= deadline);
+        if (mode == OverrunMode::Backfill) backfillForecasts(target, deadline);
+    }
 
-        if (!displayIsOn && forecast.empty() && target.epoch() % SERVER_CONFIG.idleUpdateInterval != 0) return;
-        if (!updateRealtimeImg(target)) return;
-        if (!lastUpdated) return;
-        updatePsWaveImg(target);
-        if (!lastUpdated) return;
+    void fetchFrame(Date target, bool displayIsOn, Date deadline) {
+        Date start;
+        checkForecast(target, deadline);
 
-        // resize
-        int i = 0, width = layoutConfig().imgWidth, height = layoutConfig().imgHeight;
-        uint8_t *ptr = (uint8_t*)flashImagePartition->ptr(FlashImg::MapBase8bitOriginal);
-        Bilinear::resize<uint8_t>(imgWidth, imgHeight, width, height, (uint8_t*)imgBuffer.u8, [&](int x, int y, uint8_t value) {
-            imgBuffer.u8[i++] = value;
-        }, [=](int x, int y, uint8_t value, uint8_t *r, uint8_t *g, uint8_t *b) {
-            if (value == 255) value = ptr[y * imgWidth + x];
-            *r = value & 0b11100000;
-            *g = value & 0b00011100;
-            *b = value & 0b00000011;
-        }, [](uint8_t r, uint8_t g, uint8_t b) {
-            return (r & 0b11100000) | (g & 0b00011100) | (b & 0b00000011);
-        });
+        activityPolicy.observe(Date(), !fetchedForecast.empty(), displayIsOn, intensePixels);
+        if (!activityPolicy.shouldFetch(target.epoch())) return;
+        if (Date() >= deadline) {
+            abandonedUpdates++;
+            printf("update %lld abandoned\n", (long long)target.epoch());
+            return;
+        }
+        auto job = pipeline.acquire(target);
+        if (!job) {
+            printf("update %lld dropped, render stage is behind\n", (long long)target.epoch());
+            return;
+        }
+        activityPolicy.recordFetch();
+        bool fetched = fetchRealtimeImg(job, target, deadline) && lastUpdated;
+        // the fronts are drawn locally from the hypocenters, the image is only needed without them
+        if (fetched && !fetchedForecast.isLocated() && !overrunPolicy.reduceWork()) fetchPsWaveImg(job, target, deadline);
+        pipeline.record(FramePipeline::Fetch, start);
+        if (!fetched || !lastUpdated || !renderTask.send([this, job]() { render(job); }, 0)) {
+            pipeline.release(job);
+        }
     }
 
-    void checkForecast(Date target) {
-        auto url = target.strftime(SERVER_CONFIG.forecastUrlFormat);
-        if (!httpClient.get(url) || httpClient.statusCode() != 200) return;
-        forecast.update((const char*)httpClient.buffer);
+    void checkForecast(Date target, Date deadline) {
+        auto client = fetch(HTTPEndpoint::Forecast, target.strftime(SERVER_CONFIG.forecastPathFormat), deadline);
+        if (!client || client->statusCode() != 200) return;
+        updateForecast(client, target, false);
     }
 
-    bool updateRealtimeImg(Date target) {
-        auto url = target.strftime(realtimeImgUrlFormat());
-        if (!httpClient.get(url) || httpClient.statusCode() != 200) return false;
+    void updateForecast(Networking::HTTPClient *client, Date target, bool backfilled) {
+        forecastLock.take();
+        fetchedForecast.update((const char*)client->buffer, std::min(client->received, client->bufferSize - 1), target, backfilled);
+        forecastLock.give();
+        forecastVersion++;
+    }
 
-        int i = 0;
-        GIF::Decoder decoder(httpClient.buffer, httpClient.received);
+    // Fetches the forecasts of skipped seconds with the time left before the deadline.
+    void backfillForecasts(Date target, Date deadline) {
+        time_t second;
+        while (Date() < deadline && lastUpdated && overrunPolicy.nextBackfill(second)) {
+            Date past = Date(second * 1000LL);
+            auto client = fetch(HTTPEndpoint::Forecast, past.strftime(SERVER_CONFIG.forecastPathFormat), deadline);
+            if (!client || client->statusCode() != 200) continue;
+            updateForecast(client, target, true);
+        }
+    }
+
+    bool fetchRealtimeImg(FramePipeline::Job *job, Date target, Date deadline) {
+        auto requestStart = Date();
+        auto client = fetch(HTTPEndpoint::Realtime, target.strftime(realtimeImgPathFormat()), deadline);
+        if (!client) return false;
+        timeOffsetController.record(target, requestStart, client->statusCode(), Date() - requestStart);
+        if (client->statusCode() != 200) return false;
+        return job->append(client->buffer, client->received, job->realtimeSize);
+    }
+
+    bool fetchPsWaveImg(FramePipeline::Job *job, Date target, Date deadline) {
+        auto client = fetch(HTTPEndpoint::PsWave, target.strftime(regionConfig().psWavePathFormat), deadline);
+        if (!client || client->statusCode() != 200) return false;
+        return job->append(client->buffer, client->received, job->psWaveSize);
+    }
+
+    // Render stage, runs on renderTask: decodes the images of a job over each other in imgBuffer,
+    // keeps the result for view changes and publishes it.
+    void render(FramePipeline::Job *job) {
+        Date start;
+        if (!pipeline.isDoubleBuffered()) pipeline.lock();
+        TRACE_BEGIN("decode");
         memset(imgBuffer.u8, 255, sizeof(imgBuffer.u8));
-        decoder.pixels([&](uint8_t r, uint8_t g, uint8_t b, bool transparent) {
-            if (!transparent) imgBuffer.u8[i] = lgfx::color332(r, g, b);
-            i++;
+        intensePixels = decodeOverlay(job->realtime(), job->realtimeSize, true);
+        if (job->psWaveSize > 0) decodeOverlay(job->psWave(), job->psWaveSize);
+        Date target = job->target;
+        pipeline.release(job);
+        keptOverlay.store(imgBuffer.u8, target);
+        TRACE_END("decode");
+        publishOverlay(target, start);
+    }
+
+    // Render stage, shows the kept overlay in the view changed since the last frame.
+    void reframe() {
+        Date start;
+        if (!pipeline.isDoubleBuffered()) pipeline.lock();
+        if (!keptOverlay.restore(imgBuffer.u8)) {
+            if (!pipeline.isDoubleBuffered()) pipeline.unlock();
+            return;
+        }
+        publishOverlay(keptOverlay.keptTarget(), start);
+    }
+
+    // Resizes the decoded image in imgBuffer to the layout and view and publishes it as the front frame.
+    void publishOverlay(Date target, Date start) {
+        TRACE_BEGIN("resize");
+        int width = layoutConfig().imgWidth, height = layoutConfig().imgHeight;
+        auto view = viewport.view(width, height);
+        uint8_t *pixels = view.isFit() ? resize(width, height) : resizeWindow(view, width, height);
+        TRACE_END("resize");
+        auto tweenMode = settings.tweenMode;
+        pipeline.publish(pixels, width, height, target, [&](const uint8_t *shown, const uint8_t *next) {
+            // a frame of another view is not interpolated
+            tween.capture(tweenMode, frameGeneration == view.generation ? shown : nullptr, next, width, height);
+            frameGeneration = view.generation;
         });
-        return true;
+        pipeline.record(FramePipeline::Render, start);
+        UI::send([this]() {
+            setNeedsDisplay();
+        });
+    }
+
+    // RGB332 components for the bilinear resize, transparent pixels take the base map color.
+    static void overlayRGB(uint8_t value, const uint8_t *base, uint8_t *r, uint8_t *g, uint8_t *b) {
+        if (value == 255) value = *base;
+        *r = value & 0b11100000;
+        *g = value & 0b00011100;
+        *b = value & 0b00000011;
+    }
+    static uint8_t overlayFromRGB(uint8_t r, uint8_t g, uint8_t b) {
+        return (r & 0b11100000) | (g & 0b00011100) | (b & 0b00000011);
+    }
+
+    // Resizes the decoded image in imgBuffer to the whole map in place.
+    uint8_t *resize(int width, int height) {
+        int i = 0;
+        uint8_t *ptr = (uint8_t*)flashImagePartition->ptr(FlashImg::MapBase8bitOriginal);
+        Bilinear::resize<uint8_t>(imgWidth, imgHeight, width, height, (uint8_t*)imgBuffer.u8, [&](int x, int y, uint8_t value) {
+            imgBuffer.u8[i++] = value;
+        }, [=](int x, int y, uint8_t value, uint8_t *r, uint8_t *g, uint8_t *b) {
+            overlayRGB(value, &ptr[y * imgWidth + x], r, g, b);
+        }, overlayFromRGB);
+        return imgBuffer.u8;
     }
 
-    bool updatePsWaveImg(Date target) {
-        auto url = target.strftime(regionConfig().psWaveUrlFormat);
-        if (!httpClient.get(url) || httpClient.statusCode() != 200) return false;
+    // Resizes only the part of the decoded image in imgBuffer that the view shows. The window is
+    // packed to the start of imgBuffer first and resized behind it, the result is returned.
+    uint8_t *resizeWindow(const MapViewport::View &view, int width, int height) {
+        static_assert((imgWidth / MAP_ZOOM_LEVELS[1] + 2) * (imgHeight / MAP_ZOOM_LEVELS[1] + 2) + 320 * 240 <= imgBufferSize);
+        float scaleX = (float)imgWidth / view.width, scaleY = (float)imgHeight / view.height;
+        float fx = view.originX * scaleX, fy = view.originY * scaleY, fw = width * scaleX, fh = height * scaleY;
+        int left = fx, top = fy;
+        int right = std::min<int>(imgWidth, fx + fw + 2), bottom = std::min<int>(imgHeight, fy + fh + 2);
+        int stride = right - left;
+        for (int y = top; y < bottom; y++) memmove(&imgBuffer.u8[(y - top) * stride], &imgBuffer.u8[y * imgWidth + left], stride);
 
         int i = 0;
-        GIF::Decoder decoder(httpClient.buffer, httpClient.received);
+        uint8_t *output = &imgBuffer.u8[imgBufferSize - width * height];
+        uint8_t *ptr = (uint8_t*)flashImagePartition->ptr(FlashImg::MapBase8bitOriginal);
+        Bilinear::resize<uint8_t>(stride, fx - left, fy - top, fw, fh, width, height, (uint8_t*)imgBuffer.u8, [&](int x, int y, uint8_t value) {
+            output[i++] = value;
+        }, [=](int x, int y, uint8_t value, uint8_t *r, uint8_t *g, uint8_t *b) {
+            overlayRGB(value, &ptr[(y + top) * imgWidth + x + left], r, g, b);
+        }, overlayFromRGB);
+        return output;
+    }
+
+    // Decodes over imgBuffer, returns the number of opaque pixels at or above the active intensity
+    // level if measured.
+    int decodeOverlay(const uint8_t *gif, int size, bool measure = false) {
+        int i = 0, intense = 0;
+        GIF::Decoder decoder((uint8_t*)gif, size);
         decoder.pixels([&](uint8_t r, uint8_t g, uint8_t b, bool transparent) {
-            if (!transparent) imgBuffer.u8[i] = lgfx::color332(r, g, b);
+            if (!transparent) {
+                uint8_t color = lgfx::color332(r, g, b);
+                imgBuffer.u8[i] = color;
+                if (measure && INTENSITY_LEVEL_TABLE.level[color] >= ACTIVE_INTENSITY_LEVEL) intense++;
+            }
             i++;
         });
-        return true;
+        return intense;
     }
 
     void drawRealtimeImgTypeSwitchButtons() {
@@ -279,6 +598,7 @@ class MapViewScene : public UI::Scene {
         if (!showRealtimeImgTypeSwitch) return false;
         if (now - showRealtimeImgTypeSwitch > 5000) {
             showRealtimeImgTypeSwitch = 0;
+            fullRedraw = true; // the buttons cover the bottom of the map
             return true;
         }
         auto changed = [&]() {
@@ -303,13 +623,66 @@ class MapViewScene : public UI::Scene {
         return true;
     }
 
-    void buttonAction(Date now) {
+    void drawNavigationButtons() {
+        drawButton(0, 1, viewport.isMaxZoom() ? "全体" : "拡大");
+        drawButton(1, 1, MapViewport::directionLabels[panDirection]);
+        drawButton(2, 1, "移動");
+    }
+
+    // Zoom and pan while the navigation buttons are shown, opened by holding the left button.
+    bool navigationButtonAction(Date now) {
+        if (!showNavigation) return false;
+        if (now - showNavigation > 5000) {
+            showNavigation = 0;
+            fullRedraw = true; // the buttons cover the bottom of the map
+            return true;
+        }
+        bool changed = false;
         if (M5.BtnA.wasPressed()) {
+            viewport.zoomIn();
+            if (viewport.zoom() == 1) tileCache.clear();
+            changed = true;
+        }
+        if (M5.BtnB.wasPressed()) {
+            panDirection = MapViewport::Direction((panDirection + 1) % MapViewport::DirectionCount);
+            showNavigation = now;
+            drawNavigationButtons();
+        }
+        if (M5.BtnC.wasPressed()) {
+            changed = viewport.pan(panDirection);
+            showNavigation = now;
+        }
+        if (changed) {
+            renderTask.send([this]() {
+                reframe();
+            }, 0); // if the queue is full, the next update shows the new window
+            showNavigation = now;
+            fullRedraw = true;
+            drawNavigationButtons();
+            setNeedsDisplay();
+            displayOn(now);
+        }
+        return true;
+    }
+
+    void buttonAction(Date now) {
+        if (M5.BtnA.wasHold()) {
+            showNavigation = now;
+            clearButton();
+            drawNavigationButtons();
+            displayOn(now);
+        } else if (M5.BtnA.wasClicked()) {
             lastUpdated = 0;
-            while (!bgTask1.isBlocked()) vTaskDelay(pdMS_TO_TICKS(10));
+            while (!bgTask1.isBlocked() || !renderTask.isBlocked()) vTaskDelay(pdMS_TO_TICKS(10));
             settings.setMapRegion(settings.mapRegion.next());
             flashImagePartition = flashImage.partition(regionConfig().identifier);
             prepareBaseMap();
+            renderTask.send([this]() {
+                keptOverlay.clear();
+            });
+            viewport.reset();
+            tileCache.clear();
+            fullRedraw = true;
             setNeedsDisplay();
         }
         if (M5.BtnB.wasPressed()) {
@@ -324,84 +697,144 @@ class MapViewScene : public UI::Scene {
     }
 
     void display() override {
-        if (updating && lastUpdated != 0) return;
-        if (showRealtimeImgTypeSwitch) M5.Display.setClipRect(0, 0, M5.Display.width(), 200);
+        // in single buffer mode the frame is being rendered while the lock is taken
+        if (!pipeline.lock(pipeline.isDoubleBuffered() ? portMAX_DELAY : 0)) return;
+        TRACE_SCOPE("display");
+        Date start;
+#ifdef KYOSHIN_SYNC_DISPLAY
+        // the display path before the persistent buffers, kept to compare the display stage times
+        allocateBandBuffers(MALLOC_CAP_8BIT);
+        if (!bandBuffers[0] || !bandBuffers[1]) {
+            pipeline.unlock();
+            return;
+        }
+#endif
+        bool buttonsShown = showRealtimeImgTypeSwitch || showNavigation;
+        if (buttonsShown) M5.Display.setClipRect(0, 0, M5.Display.width(), 200);
 
-        uint16_t *ptr = (uint16_t*)flashImagePartition->ptr(layoutConfig().flashImg);
+        auto &layout = layoutConfig();
+        uint16_t *ptr = (uint16_t*)flashImagePartition->ptr(layout.flashImg);
         int displayHeight = M5.Display.height();
-        int imgWidth = layoutConfig().imgWidth;
-
-        M5Canvas drawBuffer[2];
-        drawBuffer[0].createSprite(imgWidth, blockHeight);
-        drawBuffer[1].createSprite(imgWidth, blockHeight);
+        int imgWidth = layout.imgWidth;
+        bool waveFronts = forecast.isLocated();
+        Date waveFrontTime = Date() + timeOffsetController.offset(); // same time as the realtime image
+        auto view = viewport.view(imgWidth, layout.imgHeight);
+        const uint16_t *source = (uint16_t*)flashImagePartition->ptr(FlashImg::MapBase16bitOriginal);
+        const uint8_t *frame = lastUpdated > 0 && frameGeneration == view.generation ? pipeline.latest(imgWidth, layout.imgHeight) : nullptr;
+
+        if (frame) tween.step(pipeline, imgWidth, layout.imgHeight, Date());
+
+        // only the bands that changed since the last frame are pushed, unless the whole map needs a redraw
+        FramePipeline::Span spans[FramePipeline::maxBands];
+        bool overdrawn = fullRedraw || &layout != shownLayout;
+        bool full = pipeline.takeDirty(spans) || overdrawn || (frame != nullptr) != frameShown;
+        full = full || waveFronts || waveFrontsShown; // the fronts move every frame
+        fullRedraw = false;
+        shownLayout = &layout;
+        frameShown = frame != nullptr;
+        waveFrontsShown = waveFronts;
+        uint32_t pushed = 0;
+        int64_t waited = 0;
+
+        // Each band is composed into one buffer while the other one is transferred. A new transfer
+        // first waits for the previous one, so the buffer of the band pushed before that is free again.
+        // The buffers alternate over the pushed bands, skipped bands must not take a turn.
         M5.Display.startWrite();
+        int pushedBands = 0;
         for (int i = 0, top = 0; top < displayHeight; i++, top += blockHeight) {
-            if (showRealtimeImgTypeSwitch && i == 10) break;
-            int flip = i % 2, offset = top * imgWidth, height = displayHeight - top < blockHeight ? displayHeight : blockHeight;
-            drawBuffer[flip].clear(TFT_WHITE);
-            drawBuffer[flip].pushImage(0, 0, imgWidth, height, &ptr[offset]);
-            if (lastUpdated > 0 && !updating) drawBuffer[flip].pushImage(0, 0, imgWidth, height, &imgBuffer.u8[offset], (uint8_t)255);
-            drawBuffer[flip].pushSprite(&M5.Display, 0, top);
+            if (buttonsShown && i == 10) break;
+            auto &span = spans[i];
+            if (!full && span.empty()) continue;
+            int flip = pushedBands++ % 2, offset = top * imgWidth, height = displayHeight - top < blockHeight ? displayHeight : blockHeight;
+            int left = full ? 0 : span.left, width = full ? imgWidth : span.right - span.left;
+            if (view.isFit()) {
+                Composite::rect(bandBuffers[flip], width, &ptr[offset + left], frame ? &frame[offset + left] : nullptr, imgWidth, width, height);
+            } else {
+                tileCache.fill(bandBuffers[flip], width, source, view, left, top, width, height);
+                if (frame) Composite::overlayRect(bandBuffers[flip], width, &frame[offset + left], imgWidth, width, height);
+            }
+            if (waveFronts) {
+                bands[flip].setBuffer(bandBuffers[flip], width, height, 16);
+                drawWaveFronts(bands[flip], view, top, waveFrontTime);
+            }
+            int64_t pushStart = esp_timer_get_time();
+            if (bandDMA) M5.Display.pushImageDMA(left, top, width, height, (const lgfx::swap565_t*)bandBuffers[flip]);
+            else M5.Display.pushImage(left, top, width, height, (const lgfx::swap565_t*)bandBuffers[flip]);
+            waited += esp_timer_get_time() - pushStart;
+            pushed += width * height;
         }
+        pipeline.unlock();
+        int64_t pushStart = esp_timer_get_time();
+        M5.Display.waitDMA();
+        waited += esp_timer_get_time() - pushStart;
         M5.Display.endWrite();
-        drawBuffer[0].deleteSprite();
-        drawBuffer[1].deleteSprite();
+#ifdef KYOSHIN_SYNC_DISPLAY
+        for (auto &buffer : bandBuffers) {
+            heap_caps_free(buffer);
+            buffer = nullptr;
+        }
+#endif
 
-        drawForecast();
+        drawForecast(overdrawn);
+        pipeline.recordPushed(pushed, full, waited);
+        pipeline.record(FramePipeline::Display, start);
         M5.Display.clearClipRect();
     }
 
-    void drawForecast() {
-        if (!layoutConfig().forecast) return;
-
-        int displayWidth = M5.Display.width(), displayHeight = M5.Display.height();
-        int x = 212, width = displayWidth - x;
-        if (forecast.empty()) {
-            M5.Display.fillRect(x, 0, 4, displayHeight, TFT_LIGHTGRAY); x += 4; width -= 4;
-            M5.Display.fillRect(x, 0, width, 88, TFT_LIGHTGRAY);
-            M5.Display.fillRect(x, 88, width, displayHeight - 88, TFT_WHITE);
-            return;
+    // Draws the P/S-wave fronts and epicenters of the active events into the band starting at top.
+    void drawWaveFronts(M5Canvas &canvas, const MapViewport::View &view, int top, Date now) {
+        auto &projection = regionConfig().projection;
+        float degreeX = view.width / (projection.east - projection.west); // px per degree
+        float degreeY = view.height / (projection.north - projection.south);
+        for (int i = 0; i < forecast.eventCount(); i++) {
+            auto &report = forecast.event(i).report;
+            if (!report.located || report.isCancel) continue;
+            int x = (report.longitude - projection.west) * degreeX - view.originX;
+            int y = (projection.north - report.latitude) * degreeY - view.originY - top;
+            float kmX = degreeX / (111.32f * cosf(report.latitude * (float)M_PI / 180)), kmY = degreeY / 110.95f; // px per km
+            float elapsed = (now - report.originTime) / 1000.0f;
+            for (auto phase : { TravelTime::Phase::P, TravelTime::Phase::S }) {
+                float radius = TravelTime::radius(phase, report.depthKm, elapsed);
+                if (radius <= 0) continue;
+                uint32_t color = phase == TravelTime::Phase::P ? TFT_BLUE : TFT_RED;
+                int rx = radius * kmX, ry = radius * kmY;
+                canvas.drawEllipse(x, y, rx, ry, color);
+                if (rx > 1 && ry > 1) canvas.drawEllipse(x, y, rx - 1, ry - 1, color);
+            }
+            canvas.drawLine(x - 4, y - 4, x + 4, y + 4, TFT_RED);
+            canvas.drawLine(x - 4, y + 4, x + 4, y - 4, TFT_RED);
         }
+    }
+
+    // Pushes the forecast panel if a shown field changed or the panel was drawn over.
+    void drawForecast(bool overdrawn) {
+        if (!layoutConfig().forecast) return;
+        TRACE_SCOPE("drawForecast");
+        int x = 212;
+        if (forecastPanel.draw(forecast, x, M5.Display.width() - x, M5.Display.height(), overdrawn)) drawArrivalCountdown(Date());
+    }
 
-        auto backgroundColor = forecast.color();
-        M5.Display.fillRect(x, 0, 4, displayHeight, backgroundColor); x += 4; width -= 4;
+    static constexpr int countdownTop = 150, countdownHeight = 28;
+    void drawArrivalCountdown(Date now) {
+        if (!layoutConfig().forecast || forecast.empty()) return;
 
+        int x = 216, width = M5.Display.width() - x;
         M5Canvas drawBuffer(&M5.Display);
         drawBuffer.setColorDepth(2);
-        drawBuffer.createSprite(width, displayHeight);
+        drawBuffer.createSprite(width, countdownHeight);
         drawBuffer.createPalette();
         drawBuffer.setPaletteColor(0, TFT_BLACK);
         drawBuffer.setPaletteColor(1, TFT_WHITE);
-        drawBuffer.setPaletteColor(2, backgroundColor);
-
-        drawBuffer.fillRect(0, 0, width, 88, 2);
-        drawBuffer.setTextColor(1, 2);
-        drawBuffer.setFont(&lgfxJapanGothicP_24);
-        drawBuffer.drawString(forecast.alertflg.c_str(), 4, 8);
-        drawBuffer.setFont(&lgfxJapanGothicP_16);
-        drawBuffer.drawString("最大", 4, 46);
-        drawBuffer.drawString("震度", 4, 62);
-        drawBuffer.setFont(&lgfxJapanGothicP_40_numbers);
-        drawBuffer.drawCenterString(forecast.calcintensity.c_str(), width / 2 + 16, 40);
-
-        drawBuffer.fillRect(0, 88, width, displayHeight - 88, 1);
-        drawBuffer.setFont(&lgfxJapanGothicP_24);
-        drawBuffer.setTextColor(0, 1);
-        drawBuffer.drawCenterString(("M" + forecast.magnitude).c_str(), width / 2, 96);
-        drawBuffer.setFont(&lgfxJapanGothicP_16);
-        drawBuffer.drawString("深さ", 4, 128);
-        drawBuffer.setFont(&lgfxJapanGothicP_24);
-        drawBuffer.drawCenterString(forecast.depth.c_str(), width / 2, 144);
-
-        drawBuffer.setCursor(4, 176);
-        drawBuffer.setClipRect(4, 176, width - 8, 64);
-        drawBuffer.setFont(&lgfxJapanGothicP_16);
-        drawBuffer.println(forecast.regionName.c_str());
-        drawBuffer.clearClipRect();
-
-        drawBuffer.drawRightString(forecast.reportNumString().c_str(), width - 4, 218);
-
-        drawBuffer.pushSprite(x, 0);
+        drawBuffer.setPaletteColor(2, TFT_RED);
+
+        drawBuffer.clear(1);
+        if (arrivalCountdown.isValid()) {
+            int seconds = arrivalCountdown.seconds(now);
+            UI::drawText(drawBuffer, &lgfxJapanGothicP_16, "S波", 4, 8, 0);
+            UI::drawText(drawBuffer, &lgfxJapanGothicP_24, seconds > 0 ? std::to_string(seconds) + "秒" : "到達", width - 4, 2, 2, UI::TextAlign::Right);
+        }
+
+        drawBuffer.pushSprite(x, countdownTop);
         drawBuffer.deletePalette();
         drawBuffer.deleteSprite();
     }
@@ -25,7 +25,6 @@ public:
         M5.Display.drawCenterString("サウンドテスト", centerX, centerY - 12);
     }
     void eventLoop() override {
-        soundController.eventLoop();
         if (M5.BtnA.wasPressed() || M5.BtnB.wasPressed() || M5.BtnC.wasPressed()) {
             dismissScene();
         }
@@ -8,7 +8,7 @@
 class DisplaySettingsScene : public UI::ListScene {
 public:
     int numberOfRows() override {
-        return 3;
+        return 4;
     }
     void itemForRow(int row, UI::ListItem &item) override {
         switch (row) {
@@ -31,6 +31,10 @@ public:
                 return std::to_string(settings.dimDuration / 60) + "分";
             }();
             break;
+        case 3:
+            item.title = "地図の補間";
+            item.value = displayString(settings.tweenMode);
+            break;
         }
         item.button = "切替";
     }
@@ -65,6 +69,10 @@ public:
             settings.setDimDuration(nextDimDuration());
             reloadData();
             break;
+        case 3:
+            settings.setTweenMode(settings.tweenMode.next());
+            reloadData();
+            break;
         }
     }
 };
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <algorithm>
+#include "kyoshin.hpp"
+#include "config/location_config.hpp"
+
+class HomeLocationSettingsScene : public UI::ListScene {
+public:
+    HomeLocationSettingsScene() {
+        selectedRow = settings.homeLocation;
+        displayOffset = selectedRow > 2 ? std::min(selectedRow - 2, HOME_LOCATION_COUNT - 4) : 0;
+    }
+    int numberOfRows() override {
+        return HOME_LOCATION_COUNT;
+    }
+    void itemForRow(int row, UI::ListItem &item) override {
+        item.title = HOME_LOCATION_CONFIG[row].displayString;
+        if (row == settings.homeLocation) item.value = "設定中";
+    }
+    void itemSelected(int index) override {
+        settings.setHomeLocation(index);
+        reloadData();
+    }
+};
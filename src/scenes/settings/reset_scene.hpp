@@ -15,7 +15,6 @@ public:
         M5.Display.drawCenterString("初期化しますか？", centerX, centerY - 12);
     }
     void eventLoop() override {
-        soundController.eventLoop();
         if (M5.BtnA.wasPressed() || M5.BtnB.wasPressed()) {
             dismissScene();
         }
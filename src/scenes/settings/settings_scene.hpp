@@ -8,12 +8,13 @@
 #include "display_settings_scene.hpp"
 #include "sound_settings_scene.hpp"
 #include "night_mode_settings_scene.hpp"
+#include "home_location_settings_scene.hpp"
 #include "reset_scene.hpp"
 
 class SettingsScene : public UI::ListScene {
 public:
     int numberOfRows() override {
-        return 5;
+        return 7;
     }
     void itemForRow(int row, UI::ListItem &item) override {
         switch (row) {
@@ -32,6 +33,15 @@ public:
             item.title = "夜間モード";
             break;
         case 4:
+            item.title = "現在地";
+            item.value = HOME_LOCATION_CONFIG[settings.homeLocation].displayString;
+            break;
+        case 5:
+            item.title = "更新遅延時";
+            item.value = displayString(settings.overrunMode);
+            item.button = "切替";
+            break;
+        case 6:
             item.title = "リセット";
             break;
         }
@@ -52,6 +62,13 @@ public:
             presentScene(std::make_shared<NightModeSettingsScene>());
             break;
         case 4:
+            presentScene(std::make_shared<HomeLocationSettingsScene>());
+            break;
+        case 5:
+            settings.setOverrunMode(settings.overrunMode.next());
+            reloadData();
+            break;
+        case 6:
             presentScene(std::make_shared<ResetScene>());
             break;
         }
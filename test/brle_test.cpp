@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#include <random>
+#include <vector>
+#include "test.hpp"
+#include "BRLE.hpp"
+
+int main() {
+    std::mt19937 rng(1);
+    const int length = 352 * 400;
+
+    TEST("buffer encode matches the vector encode and decodes back");
+    for (int density : { 0, 1, 10, 100 }) {
+        std::vector<uint8_t> image(length, 255);
+        for (auto &pixel : image) {
+            if ((int)(rng() % 100) < density) pixel = rng() % 255;
+        }
+        std::vector<uint8_t> encoded(length * 2);
+        int size = BRLE::encode(image.data(), length, 255, encoded.data(), encoded.size());
+        CHECK(size >= 0);
+        CHECK(std::vector<uint8_t>(encoded.begin(), encoded.begin() + size) == BRLE::encode(image.data(), length, 255));
+        std::vector<uint8_t> decoded(length, 0);
+        BRLE::decode(encoded.data(), size, 255, decoded.data());
+        CHECK(decoded == image);
+    }
+
+    TEST("an image that does not fit is reported");
+    std::vector<uint8_t> image(length, 255);
+    for (int i = 0; i < length; i += 7) image[i] = 1;
+    int size = BRLE::encode(image.data(), length, 255).size();
+    std::vector<uint8_t> encoded(size);
+    CHECK(BRLE::encode(image.data(), length, 255, encoded.data(), size) == size);
+    CHECK(BRLE::encode(image.data(), length, 255, encoded.data(), size - 1) == -1);
+    CHECK(BRLE::encode(image.data(), length, 255, encoded.data(), 0) == -1);
+
+    printf("%s\n", testFailures ? "FAILED" : "OK");
+    return testFailures;
+}
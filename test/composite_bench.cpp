@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+// Composites a 320x20 map band with Composite::rect against the previous three pass path (clear,
+// copy the base, convert and write each opaque overlay pixel). Host timings only show the
+// relative cost, the display stage report gives the numbers on the device.
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "Composite.hpp"
+
+namespace {
+
+constexpr int width = 320, height = 20, iterations = 20000;
+
+void threePass(uint16_t *dst, const uint16_t *base, const uint8_t *overlay) {
+    for (int i = 0; i < width * height; i++) dst[i] = 0xffff;
+    memcpy(dst, base, width * height * sizeof(uint16_t));
+    for (int i = 0; i < width * height; i++) {
+        uint8_t color = overlay[i];
+        if (color == 255) continue;
+        uint32_t r = color >> 5, g = (color >> 2) & 0b111, b = color & 0b11;
+        uint32_t value = (((r << 2) | (r >> 1)) << 11) | (((g << 3) | g) << 5) | ((b << 3) | (b << 1) | (b >> 1));
+        dst[i] = (value >> 8) | ((value & 0xff) << 8);
+    }
+}
+
+template<class F>
+double measure(F &&func) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        func();
+        asm volatile("" ::: "memory");
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+}
+
+int main() {
+    std::mt19937 rng(1);
+    std::vector<uint16_t> base(width * height), dst(width * height);
+    std::vector<uint8_t> overlay(width * height);
+    for (auto &pixel : base) pixel = rng();
+    auto run = [&](const char *name, int density) {
+        double single = measure([&]() { Composite::rect(dst.data(), width, base.data(), overlay.data(), width, width, height); });
+        double three = measure([&]() { threePass(dst.data(), base.data(), overlay.data()); });
+        printf("  %-8s %4d%%  %11.2f  %10.2f\n", name, density, single, three);
+    };
+    printf("composite %dx%d band, us per band\n", width, height);
+    printf("  overlay  opaque  single pass  three pass\n");
+    // scattered single pixels, the worst case for the run scan
+    for (int density : { 0, 2, 10, 50, 100 }) {
+        for (auto &pixel : overlay) pixel = (int)(rng() % 100) < density ? rng() % 255 : 255;
+        run("pixels", density);
+    }
+    // 3x3 station markers like the realtime images
+    for (int stations : { 20, 100, 300 }) {
+        std::fill(overlay.begin(), overlay.end(), 255);
+        for (int i = 0; i < stations; i++) {
+            int x = rng() % (width - 2), y = rng() % (height - 2);
+            uint8_t color = rng() % 255;
+            for (int dy = 0; dy < 3; dy++) memset(&overlay[(y + dy) * width + x], color, 3);
+        }
+        int opaque = 0;
+        for (auto pixel : overlay) opaque += pixel != 255;
+        run("stations", opaque * 100 / (width * height));
+    }
+    return 0;
+}
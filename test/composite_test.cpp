@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#include <random>
+#include <vector>
+#include "test.hpp"
+#include "Composite.hpp"
+
+namespace {
+
+// Per-pixel RGB332 to byte-swapped RGB565, written out independently of the table.
+uint16_t reference(uint8_t color) {
+    int r = (color >> 5) * 31 / 7, g = ((color >> 2) & 0b111) * 63 / 7, b = (color & 0b11) * 31 / 3;
+    uint16_t value = (r << 11) | (g << 5) | b;
+    return (value >> 8) | (value << 8);
+}
+uint16_t composite(uint16_t base, uint8_t overlay, uint8_t transparent = 255) {
+    return overlay == transparent ? base : Composite::swap565(overlay);
+}
+
+std::mt19937 rng(1);
+
+std::vector<uint8_t> overlay(int size, int density, uint8_t transparent = 255) {
+    std::vector<uint8_t> pixels(size);
+    for (auto &pixel : pixels) {
+        pixel = (int)(rng() % 100) < density ? rng() % 256 : transparent;
+        if (pixel == transparent && (int)(rng() % 100) < density) pixel ^= 1;
+    }
+    return pixels;
+}
+std::vector<uint16_t> base(int size) {
+    std::vector<uint16_t> pixels(size);
+    for (auto &pixel : pixels) pixel = rng();
+    return pixels;
+}
+
+}
+
+int main() {
+    TEST("expands RGB332 to byte-swapped RGB565");
+    int mismatches = 0;
+    for (int color = 0; color < 256; color++) {
+        if (Composite::TABLE.color[color] != Composite::swap565(color)) mismatches++;
+        // bit replication and rounded scaling differ by at most one step of each component
+        uint16_t a = Composite::swap565(color), b = reference(color);
+        a = (a >> 8) | (a << 8);
+        b = (b >> 8) | (b << 8);
+        if (abs((a >> 11) - (b >> 11)) > 1 || abs(((a >> 5) & 63) - ((b >> 5) & 63)) > 1 || abs((a & 31) - (b & 31)) > 1) mismatches++;
+    }
+    CHECK(mismatches == 0);
+    CHECK(Composite::swap565(0x00) == 0x0000);
+    CHECK(Composite::swap565(0xff) == 0xffff);
+    CHECK(Composite::swap565(0xe0) == 0x00f8); // red
+    CHECK(Composite::swap565(0x1c) == 0xe007); // green
+    CHECK(Composite::swap565(0x03) == 0x1f00); // blue
+
+    TEST("row matches the per-pixel composite");
+    mismatches = 0;
+    for (int trial = 0; trial < 2000; trial++) {
+        int width = 1 + rng() % 330, density = rng() % 101;
+        auto src = base(width);
+        auto over = overlay(width + 3, density);
+        int shift = rng() % 4; // unaligned overlay rows
+        std::vector<uint16_t> dst(width + 1, 0xdead);
+        Composite::row(dst.data(), src.data(), over.data() + shift, width);
+        for (int i = 0; i < width; i++) {
+            if (dst[i] != composite(src[i], over[i + shift])) mismatches++;
+        }
+        if (dst[width] != 0xdead) mismatches++;
+        Composite::row(dst.data(), src.data(), nullptr, width);
+        for (int i = 0; i < width; i++) {
+            if (dst[i] != src[i]) mismatches++;
+        }
+    }
+    CHECK(mismatches == 0);
+
+    TEST("row honours another transparent key");
+    auto src = base(64);
+    auto over = overlay(64, 30, 0);
+    std::vector<uint16_t> dst(64);
+    Composite::row(dst.data(), src.data(), over.data(), 64, 0);
+    mismatches = 0;
+    for (int i = 0; i < 64; i++) {
+        if (dst[i] != composite(src[i], over[i], 0)) mismatches++;
+    }
+    CHECK(mismatches == 0);
+
+    TEST("overlayRow keeps the transparent pixels of dst");
+    mismatches = 0;
+    for (int trial = 0; trial < 2000; trial++) {
+        int width = 1 + rng() % 330, density = rng() % 101;
+        auto before = base(width + 1);
+        auto over = overlay(width, density);
+        auto dst = before;
+        Composite::overlayRow(dst.data(), over.data(), width);
+        for (int i = 0; i < width; i++) {
+            if (dst[i] != composite(before[i], over[i])) mismatches++;
+        }
+        if (dst[width] != before[width]) mismatches++;
+    }
+    CHECK(mismatches == 0);
+
+    TEST("rect and overlayRect follow the strides");
+    const int srcStride = 50, dstStride = 20, width = 17, height = 6;
+    auto block = base(srcStride * height);
+    auto blockOverlay = overlay(srcStride * height, 40);
+    std::vector<uint16_t> out(dstStride * height, 0xdead);
+    Composite::rect(out.data(), dstStride, block.data() + 3, blockOverlay.data() + 3, srcStride, width, height);
+    mismatches = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < dstStride; x++) {
+            uint16_t expected = x < width ? composite(block[y * srcStride + 3 + x], blockOverlay[y * srcStride + 3 + x]) : 0xdead;
+            if (out[y * dstStride + x] != expected) mismatches++;
+        }
+    }
+    CHECK(mismatches == 0);
+    auto before = base(dstStride * height);
+    out = before;
+    Composite::overlayRect(out.data(), dstStride, blockOverlay.data(), srcStride, width, height);
+    mismatches = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < dstStride; x++) {
+            uint16_t expected = x < width ? composite(before[y * dstStride + x], blockOverlay[y * srcStride + x]) : before[y * dstStride + x];
+            if (out[y * dstStride + x] != expected) mismatches++;
+        }
+    }
+    CHECK(mismatches == 0);
+
+    printf("%s\n", testFailures ? "FAILED" : "OK");
+    return testFailures;
+}
@@ -0,0 +1,8 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <cstdint>
+
+int64_t esp_timer_get_time(); // usec since start
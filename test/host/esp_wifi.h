@@ -0,0 +1,9 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include <cstdint>
+#include "esp_err.h"
+
+typedef struct { struct { uint8_t ssid[32]; uint8_t password[64]; } sta; } wifi_config_t;
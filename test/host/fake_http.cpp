@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "esp_http_client.h"
+#include "networking.hpp"
+#include "fake_http.hpp"
+
+struct esp_http_client {
+    esp_http_client_config_t config;
+    std::string url;
+    int status = 0;
+    std::atomic<bool> running = false;
+    std::atomic<bool> cancelled = false;
+};
+
+namespace {
+
+struct Server {
+    int delayMs = 0;
+    int status = 200;
+    int performed = 0;
+    int cancelled = 0;
+};
+std::mutex mutex;
+std::map<std::string, Server> servers;
+std::atomic<int> performingCount = 0;
+std::atomic<int> unsafeCleanupCount = 0;
+
+std::string hostOf(const std::string &url) {
+    size_t begin = url.find("://") + 3;
+    return url.substr(begin, url.find_first_of(":/", begin) - begin);
+}
+std::string pathOf(const std::string &url) {
+    size_t begin = url.find('/', url.find("://") + 3);
+    return begin == std::string::npos ? "/" : url.substr(begin);
+}
+
+esp_err_t emit(esp_http_client *client, esp_http_client_event_id_t id, const char *data = nullptr, int length = 0) {
+    esp_http_client_event_t event = {};
+    event.event_id = id;
+    event.client = client;
+    event.data = (void *)data;
+    event.data_len = length;
+    event.user_data = client->config.user_data;
+    return client->config.event_handler(&event);
+}
+
+}
+
+namespace FakeHTTP {
+
+void setServer(const std::string &host, int delayMs, int status) {
+    std::lock_guard lock(mutex);
+    servers[host].delayMs = delayMs;
+    servers[host].status = status;
+}
+int performing() {
+    return performingCount;
+}
+int performed(const std::string &host) {
+    std::lock_guard lock(mutex);
+    return servers[host].performed;
+}
+int cancelled(const std::string &host) {
+    std::lock_guard lock(mutex);
+    return servers[host].cancelled;
+}
+int unsafeCleanups() {
+    return unsafeCleanupCount;
+}
+
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config) {
+    auto client = new esp_http_client();
+    client->config = *config;
+    client->url = config->url;
+    return client;
+}
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+    if (client->running) unsafeCleanupCount++;
+    delete client;
+    return ESP_OK;
+}
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url) {
+    client->url = url;
+    return ESP_OK;
+}
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t, const char *, const char *) {
+    return ESP_OK;
+}
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t, esp_http_client_method_t) {
+    return ESP_OK;
+}
+esp_err_t esp_http_client_set_timeout_ms(esp_http_client_handle_t client, int timeout_ms) {
+    client->config.timeout_ms = timeout_ms;
+    return ESP_OK;
+}
+esp_err_t esp_http_client_set_redirection(esp_http_client_handle_t) {
+    return ESP_OK;
+}
+esp_err_t esp_http_client_cancel_request(esp_http_client_handle_t client) {
+    client->cancelled = true;
+    return ESP_OK;
+}
+int esp_http_client_get_status_code(esp_http_client_handle_t client) {
+    return client->status;
+}
+bool esp_http_client_is_chunked_response(esp_http_client_handle_t) {
+    return false;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client) {
+    std::string host = hostOf(client->url), body = host + " " + pathOf(client->url);
+    Server server;
+    {
+        std::lock_guard lock(mutex);
+        auto &entry = servers[host];
+        entry.performed++;
+        server = entry;
+    }
+    client->running = true;
+    client->cancelled = false;
+    client->status = 0;
+    performingCount++;
+    auto finish = [&](esp_err_t err) {
+        if (client->cancelled) {
+            std::lock_guard lock(mutex);
+            servers[host].cancelled++;
+        }
+        performingCount--;
+        client->running = false;
+        return err;
+    };
+
+    emit(client, HTTP_EVENT_ON_CONNECTED);
+    emit(client, HTTP_EVENT_HEADER_SENT);
+    if (server.delayMs > client->config.timeout_ms) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(client->config.timeout_ms));
+        return finish(ESP_ERR_TIMEOUT);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(server.delayMs));
+    client->status = server.status;
+    emit(client, HTTP_EVENT_ON_HEADER);
+    if (client->cancelled) return finish(ESP_FAIL);
+    size_t half = body.size() / 2;
+    emit(client, HTTP_EVENT_ON_DATA, body.data(), half);
+    if (client->cancelled) return finish(ESP_FAIL);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    emit(client, HTTP_EVENT_ON_DATA, body.data() + half, body.size() - half);
+    if (client->cancelled) return finish(ESP_FAIL);
+    emit(client, HTTP_EVENT_ON_FINISH);
+    return finish(ESP_OK);
+}
+
+// Name resolution is not used by the stand-in servers.
+namespace Networking {
+bool resolve(const string &, string &) { return false; }
+void setStaticAddress(const string &, const string &) {}
+void invalidateAddress(const string &) {}
+}
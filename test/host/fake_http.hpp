@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+// Stand-in HTTP servers behind the esp_http_client API. A request blocks for the server's delay
+// before the first header, like a slow connect or a slow server, and only checks for cancellation
+// from the header on, like esp_http_client. The body is "<host> <path>".
+#pragma once
+#include <string>
+
+namespace FakeHTTP {
+
+void setServer(const std::string &host, int delayMs, int status = 200);
+int performing();       // requests currently inside esp_http_client_perform
+int performed(const std::string &host);
+int cancelled(const std::string &host);
+int unsafeCleanups();   // clients cleaned up while a request was running on them
+
+}
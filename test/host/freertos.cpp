@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+const Clock::time_point startTime = Clock::now();
+
+// Blocks on cv until ready() or the ticks have passed, returns ready().
+template<class F>
+bool waitFor(std::unique_lock<std::mutex> &lock, std::condition_variable &cv, TickType_t ticks, F ready) {
+    if (ticks == portMAX_DELAY) {
+        cv.wait(lock, ready);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), ready);
+}
+
+struct Task {
+    std::string name;
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t notifications = 0;
+};
+thread_local Task *currentTask = nullptr;
+
+// Queues carry fixed size items, semaphores are queues of empty items.
+struct Queue {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length, itemSize;
+    Queue(UBaseType_t length, UBaseType_t itemSize) : length(length), itemSize(itemSize) {}
+
+    bool send(const void *item, TickType_t ticks) {
+        std::unique_lock lock(mutex);
+        if (!waitFor(lock, changed, ticks, [&] { return items.size() < length; })) return false;
+        auto bytes = static_cast<const uint8_t *>(item);
+        items.emplace_back(bytes, bytes + (item ? itemSize : 0));
+        changed.notify_all();
+        return true;
+    }
+    bool receive(void *item, TickType_t ticks) {
+        std::unique_lock lock(mutex);
+        if (!waitFor(lock, changed, ticks, [&] { return !items.empty(); })) return false;
+        if (item) memcpy(item, items.front().data(), items.front().size());
+        items.pop_front();
+        changed.notify_all();
+        return true;
+    }
+};
+
+struct EventGroup {
+    std::mutex mutex;
+    std::condition_variable changed;
+    EventBits_t bits = 0;
+};
+
+std::recursive_mutex criticalSection;
+
+}
+
+void portENTER_CRITICAL(portMUX_TYPE *) {
+    criticalSection.lock();
+}
+void portEXIT_CRITICAL(portMUX_TYPE *) {
+    criticalSection.unlock();
+}
+
+int64_t esp_timer_get_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - startTime).count();
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t func, const char *name, uint32_t, void *arg, UBaseType_t, TaskHandle_t *handle, BaseType_t) {
+    auto task = new Task();
+    task->name = name;
+    if (handle) *handle = task;
+    std::thread([task, func, arg]() {
+        currentTask = task;
+        func(arg);
+    }).detach();
+    return pdPASS;
+}
+// Threads cannot be stopped from outside, a deleted task keeps its thread until the process exits.
+void vTaskDelete(TaskHandle_t) {}
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    if (!currentTask) {
+        currentTask = new Task();
+        currentTask->name = "main";
+    }
+    return currentTask;
+}
+char *pcTaskGetName(TaskHandle_t handle) {
+    return static_cast<Task *>(handle ? handle : xTaskGetCurrentTaskHandle())->name.data();
+}
+eTaskState eTaskGetState(TaskHandle_t) {
+    return eBlocked;
+}
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+}
+std::atomic<TickType_t> tickOffset = 0;
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)(esp_timer_get_time() / 1000 / portTICK_PERIOD_MS) + tickOffset;
+}
+void hostSetTickCount(TickType_t ticks) {
+    tickOffset = ticks - (TickType_t)(esp_timer_get_time() / 1000 / portTICK_PERIOD_MS);
+}
+BaseType_t xTaskNotifyGive(TaskHandle_t handle) {
+    auto task = static_cast<Task *>(handle);
+    std::lock_guard lock(task->mutex);
+    task->notifications++;
+    task->cv.notify_all();
+    return pdPASS;
+}
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    auto task = static_cast<Task *>(xTaskGetCurrentTaskHandle());
+    std::unique_lock lock(task->mutex);
+    waitFor(lock, task->cv, ticks, [&] { return task->notifications > 0; });
+    uint32_t value = task->notifications;
+    if (value) task->notifications = clearOnExit ? 0 : value - 1;
+    return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    return new Queue(length, itemSize);
+}
+void vQueueDelete(QueueHandle_t queue) {
+    delete static_cast<Queue *>(queue);
+}
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    return static_cast<Queue *>(queue)->send(item, ticks);
+}
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+    return static_cast<Queue *>(queue)->receive(item, ticks);
+}
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t handle) {
+    auto queue = static_cast<Queue *>(handle);
+    std::lock_guard lock(queue->mutex);
+    return queue->items.size();
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return new Queue(1, 0);
+}
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) {
+    auto queue = new Queue(max, 0);
+    for (UBaseType_t i = 0; i < initial; i++) queue->send(nullptr, 0);
+    return queue;
+}
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return xSemaphoreCreateCounting(1, 1);
+}
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    vQueueDelete(semaphore);
+}
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    return static_cast<Queue *>(semaphore)->send(nullptr, 0);
+}
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    return static_cast<Queue *>(semaphore)->receive(nullptr, ticks);
+}
+
+EventGroupHandle_t xEventGroupCreate() {
+    return new EventGroup();
+}
+void vEventGroupDelete(EventGroupHandle_t group) {
+    delete static_cast<EventGroup *>(group);
+}
+EventBits_t xEventGroupGetBits(EventGroupHandle_t handle) {
+    auto group = static_cast<EventGroup *>(handle);
+    std::lock_guard lock(group->mutex);
+    return group->bits;
+}
+EventBits_t xEventGroupSetBits(EventGroupHandle_t handle, EventBits_t bits) {
+    auto group = static_cast<EventGroup *>(handle);
+    std::lock_guard lock(group->mutex);
+    group->bits |= bits;
+    group->changed.notify_all();
+    return group->bits;
+}
+EventBits_t xEventGroupClearBits(EventGroupHandle_t handle, EventBits_t bits) {
+    auto group = static_cast<EventGroup *>(handle);
+    std::lock_guard lock(group->mutex);
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t handle, EventBits_t bits, BaseType_t clearOnExit, BaseType_t waitForAll, TickType_t ticks) {
+    auto group = static_cast<EventGroup *>(handle);
+    std::unique_lock lock(group->mutex);
+    auto ready = [&] { return waitForAll ? (group->bits & bits) == bits : (group->bits & bits) != 0; };
+    waitFor(lock, group->changed, ticks, ready);
+    EventBits_t value = group->bits;
+    if (clearOnExit && ready()) group->bits &= ~bits;
+    return value;
+}
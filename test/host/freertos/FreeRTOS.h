@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+// Host stand-in for the FreeRTOS API used by lib/system, backed by std::thread. Ticks are 10ms
+// like the firmware (CONFIG_FREERTOS_HZ=100), priorities and cores are ignored.
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+typedef uint32_t TickType_t;
+typedef unsigned UBaseType_t;
+typedef int BaseType_t;
+typedef uint32_t EventBits_t;
+typedef void *TaskHandle_t;
+typedef void *QueueHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef void *EventGroupHandle_t;
+typedef void *TimerHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define portMAX_DELAY 0xffffffffu
+#define portTICK_PERIOD_MS 10
+#define portNUM_PROCESSORS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms) / portTICK_PERIOD_MS)
+#define tskIDLE_PRIORITY 0
+#define configMAX_PRIORITIES 25
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS 1
+
+typedef struct { int unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+void portENTER_CRITICAL(portMUX_TYPE *mux);
+void portEXIT_CRITICAL(portMUX_TYPE *mux);
+inline int xPortGetCoreID() { return 0; }
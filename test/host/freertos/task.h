@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include "FreeRTOS.h"
+
+enum eTaskState { eRunning, eReady, eBlocked, eSuspended, eDeleted };
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t func, const char *name, uint32_t stackDepth, void *arg,
+    UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+void vTaskDelete(TaskHandle_t handle);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+char *pcTaskGetName(TaskHandle_t handle);
+eTaskState eTaskGetState(TaskHandle_t handle);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+// Host only: moves the tick count so that it reads ticks now, to test the counter wrapping around.
+void hostSetTickCount(TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t handle);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
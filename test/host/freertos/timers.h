@@ -0,0 +1,6 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#pragma once
+#include "FreeRTOS.h"
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include "test.hpp"
+#include "json_scanner.hpp"
+
+namespace {
+
+// Shape of the forecast response of the server
+const char *EEW_REPORT = R"({"result":{"status":"success","message":"","is_auth":true},
+"report_time":"2024/01/01 16:10:31","region_code":"","request_time":"20240101161031","region_name":"石川県能登地方",
+"longitude":"137.2","is_cancel":false,"depth":"10km","calcintensity":"7","is_final":true,"is_training":false,"latitude":"37.5",
+"origin_time":"20240101161006","security":{"realm":"/kyoshin_monitor/static/jsondata/eew_est/","hash":"b61e4d95a8c42e004665825c098a6de4"},
+"magunitude":"7.4","report_num":"15","request_hypo_type":"eew","report_id":"20240101161013","alertflg":"警報","points":[1,[2,{"x":3}]]})";
+
+struct Member {
+    std::string path, key, raw;
+    JSONScanner::Type type;
+};
+
+std::vector<Member> scanAll(const char *json) {
+    std::vector<Member> members;
+    bool ok = JSONScanner::scan(json, strlen(json), [&](std::string_view path, std::string_view key, const JSONScanner::Value &value) {
+        members.push_back({ std::string(path), std::string(key), std::string(value.raw), value.type });
+    });
+    if (!ok) members.clear();
+    return members;
+}
+
+const Member *find(const std::vector<Member> &members, const char *path, const char *key) {
+    for (auto &member : members) {
+        if (member.path == path && member.key == key) return &member;
+    }
+    return nullptr;
+}
+
+}
+
+int main() {
+    TEST("reports top level and nested members");
+    auto members = scanAll(EEW_REPORT);
+    auto status = find(members, "result", "status");
+    CHECK(status && status->raw == "success" && status->type == JSONScanner::Type::String);
+    auto id = find(members, "", "report_id");
+    CHECK(id && id->raw == "20240101161013");
+    auto final = find(members, "", "is_final");
+    CHECK(final && final->type == JSONScanner::Type::True);
+    auto points = find(members, "", "points");
+    CHECK(points && points->type == JSONScanner::Type::Array && points->raw == "[1,[2,{\"x\":3}]]");
+    CHECK(!find(members, "points", "x")); // members inside arrays are skipped
+    CHECK(find(members, "security", "hash"));
+
+    TEST("unescapes strings into fixed buffers");
+    FixedString<64> region;
+    JSONScanner::Value value = { JSONScanner::Type::String, find(members, "", "region_name")->raw };
+    value.stringValue(region);
+    CHECK(region == "石川県能登地方");
+    FixedString<8> alert;
+    value = { JSONScanner::Type::String, "\\u8b66\\u5831" };
+    value.stringValue(alert);
+    CHECK(alert == "警報");
+    FixedString<8> escaped;
+    value = { JSONScanner::Type::String, "a\\\"b\\\\c\\n" };
+    value.stringValue(escaped);
+    CHECK(escaped == "a\"b\\c\n");
+    FixedString<8> surrogate;
+    value = { JSONScanner::Type::String, "\\ud83c\\udf0a" };
+    value.stringValue(surrogate);
+    CHECK(surrogate == "\xf0\x9f\x8c\x8a");
+    FixedString<8> number;
+    value = { JSONScanner::Type::Number, "7.4" };
+    value.stringValue(number);
+    CHECK(number.empty());
+
+    TEST("truncates on a character boundary");
+    FixedString<8> truncated;
+    value = { JSONScanner::Type::String, "石川県" }; // 9 bytes
+    value.stringValue(truncated);
+    CHECK(truncated == "石川");
+    value = { JSONScanner::Type::String, "ab\\u77f3\\u5ddd\\u770c" };
+    value.stringValue(truncated);
+    CHECK(truncated == "ab石川");
+
+    TEST("rejects malformed input");
+    CHECK(scanAll("").empty());
+    CHECK(scanAll("[1,2]").empty());
+    CHECK(scanAll("{\"a\":1").empty());
+    CHECK(scanAll("{\"a\" 1}").empty());
+    CHECK(scanAll("{\"a\":\"open}").empty());
+    std::string deep = "{\"a\":" + std::string(20, '[') + std::string(20, ']') + "}";
+    CHECK(scanAll(deep.c_str()).empty());
+    CHECK(scanAll("{}").empty() && JSONScanner::scan("{}", 2, [](auto, auto, auto &) {}));
+
+    printf("%s\n", testFailures ? "FAILED" : "OK");
+    return testFailures;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+// Races two stand-in servers with injected delays through MirrorClient and the real HTTPClient.
+#include <cstring>
+#include "test.hpp"
+#include "host/fake_http.hpp"
+#include "modules/mirror_client.hpp"
+
+namespace {
+
+constexpr ServerConfig config(const char *secondary) {
+    ServerConfig config = {};
+    config.mirrors[0] = { "http://primary", nullptr };
+    config.mirrors[1] = { secondary, nullptr };
+    config.hedgePercentile = 90;
+    config.hedgeMinDelay = 100;
+    return config;
+}
+constexpr ServerConfig TWO_MIRRORS = config("http://secondary");
+constexpr ServerConfig ONE_MIRROR = config(nullptr);
+
+bool body(Networking::HTTPClient *client, const char *expected) {
+    return client && strcmp((const char *)client->buffer, expected) == 0;
+}
+
+bool waitIdle(MirrorClient &mirrors, int timeoutMs) {
+    for (Date start; Date() - start < timeoutMs; RTOS::delay(10)) {
+        if (mirrors.isIdle()) return true;
+    }
+    return false;
+}
+
+// The mirror tasks cannot be stopped, so the clients live until the process exits.
+MirrorClient &startMirrors(const ServerConfig &config) {
+    auto primary = new Networking::HTTPClient(1024);
+    primary->clearBuffer();
+    auto mirrors = new MirrorClient();
+    mirrors->start(*primary, 1024, config);
+    return *mirrors;
+}
+
+}
+
+int main() {
+    auto &mirrors = startMirrors(TWO_MIRRORS);
+    auto get = [&](const char *path, int budget) {
+        return mirrors.get(HTTPEndpoint::Realtime, path, Date() + budget);
+    };
+
+    TEST("fast primary is not hedged");
+    FakeHTTP::setServer("primary", 20);
+    FakeHTTP::setServer("secondary", 20);
+    for (int i = 0; i < 3; i++) CHECK(body(get("/a", 1000), "primary /a"));
+    CHECK(waitIdle(mirrors, 500));
+    CHECK(FakeHTTP::performed("secondary") == 0);
+    CHECK(mirrors.stats(0).wins == 3);
+    CHECK(mirrors.stats(1).requests == 0);
+
+    TEST("slow primary loses to the hedge");
+    FakeHTTP::setServer("primary", 400);
+    FakeHTTP::setServer("secondary", 30);
+    Date start;
+    CHECK(body(get("/b", 1000), "secondary /b"));
+    int elapsed = Date() - start;
+    CHECK(elapsed >= 100 && elapsed < 300);
+    CHECK(mirrors.stats(1).hedges == 1);
+    CHECK(mirrors.stats(1).wins == 1);
+
+    TEST("reset waits for the cancelled loser");
+    CHECK(!mirrors.isIdle());
+    CHECK(!mirrors.reset());
+    CHECK(FakeHTTP::performing() == 1);
+    CHECK(waitIdle(mirrors, 1000));
+    CHECK(FakeHTTP::cancelled("primary") == 1);
+    CHECK(mirrors.reset());
+    CHECK(FakeHTTP::unsafeCleanups() == 0);
+
+    TEST("loser of the previous request does not answer the next one");
+    CHECK(body(get("/c", 1000), "secondary /c"));
+    FakeHTTP::setServer("primary", 20);
+    CHECK(body(get("/d", 1000), "secondary /d")); // the primary task is still busy with /c
+    CHECK(waitIdle(mirrors, 1000));
+    int performed = FakeHTTP::performed("primary");
+    start = Date();
+    CHECK(body(get("/e", 1000), "primary /e"));
+    CHECK(Date() - start < 100);
+    CHECK(FakeHTTP::performed("primary") == performed + 1); // /d was skipped once cancelled
+
+    TEST("failed primary falls over without waiting for the hedge delay");
+    FakeHTTP::setServer("primary", 10, 500);
+    FakeHTTP::setServer("secondary", 10);
+    start = Date();
+    CHECK(body(get("/f", 1000), "secondary /f"));
+    CHECK(Date() - start < 100);
+    CHECK(waitIdle(mirrors, 500));
+
+    TEST("no mirror answers within the deadline");
+    FakeHTTP::setServer("primary", 500);
+    FakeHTTP::setServer("secondary", 500);
+    start = Date();
+    CHECK(get("/g", 200) == nullptr);
+    CHECK(Date() - start < 300);
+    CHECK(waitIdle(mirrors, 1000));
+    CHECK(mirrors.reset());
+
+    TEST("each mirror counts its own requests");
+    auto &primaryStats = mirrors.httpStats(0, HTTPEndpoint::Realtime), &secondaryStats = mirrors.httpStats(1, HTTPEndpoint::Realtime);
+    CHECK((int)primaryStats.requests == FakeHTTP::performed("primary"));
+    CHECK((int)secondaryStats.requests == FakeHTTP::performed("secondary"));
+    CHECK(mirrors.httpStats(0, HTTPEndpoint::Forecast).requests == 0);
+    CHECK(FakeHTTP::unsafeCleanups() == 0);
+
+    TEST("single mirror requests in place");
+    auto &single = startMirrors(ONE_MIRROR);
+    FakeHTTP::setServer("primary", 20);
+    CHECK(body(single.get(HTTPEndpoint::Forecast, "/h", Date() + 1000), "primary /h"));
+    CHECK(single.isIdle());
+    CHECK(single.httpStats(0, HTTPEndpoint::Forecast).requests == 1);
+
+    mirrors.print();
+    printf("%s\n", testFailures ? "FAILED" : "OK");
+    return testFailures;
+}
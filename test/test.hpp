@@ -0,0 +1,18 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+// Minimal checks for the host tests, each test binary returns the number of failed checks.
+#pragma once
+#include <cstdio>
+
+inline int testFailures = 0;
+
+#define CHECK(condition) do {                                                   \
+        if (!(condition)) {                                                     \
+            printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);       \
+            testFailures++;                                                     \
+        }                                                                       \
+    } while (0)
+
+#define TEST(name) printf("%s\n", name)
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+#include <atomic>
+#include "test.hpp"
+#include "rtos.hpp"
+#include "date.hpp"
+
+namespace {
+
+bool waitFor(const std::atomic<int> &value, int expected, int timeoutMs) {
+    for (Date start; Date() - start < timeoutMs; RTOS::delay(10)) {
+        if (value == expected) return true;
+    }
+    return value == expected;
+}
+
+}
+
+int main() {
+    // the tick count wraps around 200ms into the tests
+    hostSetTickCount(UINT32_MAX - 20);
+    // the task cannot be stopped, so the wheel lives until the process exits
+    auto &wheel = *new RTOS::TimerWheel();
+
+    TEST("keeps time across the tick count wrapping around");
+    std::atomic<int> fired = 0, repeated = 0;
+    std::atomic<int64_t> firedAt = 0;
+    Date start;
+    auto periodic = wheel.schedule(100, 100, [&]() { repeated++; });
+    wheel.schedule(500, 0, [&]() {
+        firedAt = Date() - start;
+        fired++;
+    });
+    CHECK(waitFor(fired, 1, 1000));
+    CHECK(xTaskGetTickCount() < 100);
+    CHECK(firedAt >= 490 && firedAt < 600);
+    CHECK(wheel.cancel(periodic));
+    CHECK(repeated >= 4 && repeated <= 6);
+
+    TEST("fires a timeout once at its time");
+    fired = 0;
+    start = Date();
+    wheel.schedule(300, 0, [&]() {
+        firedAt = Date() - start;
+        fired++;
+    });
+    CHECK(waitFor(fired, 1, 1000));
+    CHECK(firedAt >= 290 && firedAt < 400);
+    RTOS::delay(200);
+    CHECK(fired == 1);
+
+    TEST("sleeps while no timer is due");
+    uint32_t wakeups = wheel.wakeupCount();
+    RTOS::delay(500);
+    CHECK(wheel.wakeupCount() == wakeups);
+    fired = 0;
+    start = Date();
+    wheel.schedule(500, 0, [&]() { fired++; });
+    RTOS::delay(300);
+    CHECK(wheel.wakeupCount() - wakeups <= 2); // woken by the schedule, then sleeping until due
+    CHECK(waitFor(fired, 1, 1000));
+    CHECK(wheel.wakeupCount() - wakeups <= 4);
+
+    TEST("an earlier timer wakes the sleeping task");
+    std::atomic<int> order = 0, late = 0, early = 0;
+    start = Date();
+    wheel.schedule(1500, 0, [&]() { late = ++order; });
+    RTOS::delay(50);
+    wheel.schedule(100, 0, [&]() {
+        firedAt = Date() - start;
+        early = ++order;
+    });
+    CHECK(waitFor(early, 1, 500));
+    CHECK(firedAt >= 140 && firedAt < 300);
+    CHECK(waitFor(late, 2, 2000));
+
+    TEST("cancelled timers do not fire");
+    fired = 0;
+    auto id = wheel.schedule(200, 0, [&]() { fired++; });
+    CHECK(wheel.isPending(id));
+    CHECK(wheel.cancel(id));
+    CHECK(!wheel.isPending(id));
+    RTOS::delay(400);
+    CHECK(fired == 0);
+    CHECK(!wheel.cancel(id));
+
+    TEST("periodic timers repeat until cancelled");
+    fired = 0;
+    id = wheel.schedule(100, 100, [&]() { fired++; });
+    RTOS::delay(550);
+    CHECK(wheel.cancel(id));
+    int count = fired;
+    CHECK(count >= 4 && count <= 6);
+    RTOS::delay(300);
+    CHECK(fired == count);
+
+    TEST("timers beyond the first level cascade in time");
+    fired = 0;
+    start = Date();
+    wheel.schedule(1300, 0, [&]() { // 130 ticks, on the second level
+        firedAt = Date() - start;
+        fired++;
+    });
+    CHECK(waitFor(fired, 1, 2000));
+    CHECK(firedAt >= 1290 && firedAt < 1400);
+
+    wheel.print();
+    printf("%s\n", testFailures ? "FAILED" : "OK");
+    return testFailures;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2024 Hiroki Kawakami
+ */
+
+// Built with KYOSHIN_TRACE and a small ring, see the Makefile.
+#include <cstring>
+#include "test.hpp"
+#include "trace.hpp"
+
+namespace {
+
+const Trace::Event &event(uint32_t index) {
+    return Trace::rings[0].events[index & (Trace::capacity - 1)];
+}
+
+}
+
+int main() {
+    TEST("records begin and end markers in order");
+    {
+        TRACE_SCOPE("outer");
+        TRACE_BEGIN("inner");
+        TRACE_END("inner");
+    }
+    CHECK(Trace::rings[0].head == 4);
+    const char *names[] = { "outer", "inner", "inner", "outer" };
+    const char phases[] = { 'B', 'B', 'E', 'E' };
+    for (uint32_t i = 0; i < 4; i++) {
+        CHECK(event(i).sequence == i + 1);
+        CHECK(strcmp(event(i).name, names[i]) == 0);
+        CHECK(event(i).phase == phases[i]);
+    }
+    CHECK(event(0).time <= event(3).time);
+
+    TEST("overwrites the oldest events when full");
+    for (uint32_t i = 0; i < Trace::capacity; i++) TRACE_BEGIN("fill");
+    uint32_t head = Trace::rings[0].head;
+    CHECK(head == Trace::capacity + 4);
+    for (uint32_t i = head - Trace::capacity; i < head; i++) CHECK(event(i).sequence == i + 1);
+
+    TRACE_DUMP();
+    printf("%s\n", testFailures ? "FAILED" : "OK");
+    return testFailures;
+}